@@ -0,0 +1,193 @@
+#include "CAggregator.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <string>
+
+// the AVX2 loop of addNumbers is only built with -mavx2 or -march set to a machine that has it (see ARCH
+// in Makefile), the default build uses the scalar loop
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct CFunctionName
+    {
+        const char *m_name;
+        CAggregateKind m_kind;
+    };
+
+    constexpr std::array<CFunctionName, 5> FUNCTIONS = {{{"SUM", CAggregateKind::SUM},
+                                                          {"MIN", CAggregateKind::MIN},
+                                                          {"MAX", CAggregateKind::MAX},
+                                                          {"COUNT", CAggregateKind::COUNT},
+                                                          {"AVG", CAggregateKind::AVG}}};
+}
+
+CTotals CTotals::of(const CContent &value, bool isKnown)
+{
+    CTotals totals;
+    if (!isKnown)
+    {
+        totals.m_unknown = 1;
+    }
+    else if (value.isDouble())
+    {
+        totals.m_sum = value.getDouble();
+        totals.m_numbers = 1;
+        totals.m_values = 1;
+    }
+    else if (value.isString())
+    {
+        totals.m_values = 1;
+    }
+    return totals;
+}
+
+CTotals &CTotals::operator+=(const CTotals &other)
+{
+    m_sum += other.m_sum;
+    m_numbers += other.m_numbers;
+    m_values += other.m_values;
+    m_unknown += other.m_unknown;
+    return *this;
+}
+
+std::optional<CAggregateKind> CAggregator::kindOf(std::string_view name)
+{
+    std::string upper(name);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char ch)
+                   { return std::toupper(ch); });
+    for (const CFunctionName &function : FUNCTIONS)
+    {
+        if (upper == function.m_name)
+        {
+            return function.m_kind;
+        }
+    }
+    return std::nullopt;
+}
+
+const char *CAggregator::nameOf(CAggregateKind kind)
+{
+    for (const CFunctionName &function : FUNCTIONS)
+    {
+        if (function.m_kind == kind)
+        {
+            return function.m_name;
+        }
+    }
+    return "";
+}
+
+void CAggregator::add(const CContent &value)
+{
+    m_totals += CTotals::of(value);
+    if (value.isDouble())
+    {
+        m_min = std::min(m_min, value.getDouble());
+        m_max = std::max(m_max, value.getDouble());
+    }
+}
+
+void CAggregator::addNumbers(const double *numbers, uint64_t mask)
+{
+    static_assert(BLOCK_SIZE == 64, "a block has one bit of mask per number");
+    if (!mask)
+    {
+        return;
+    }
+    m_totals.m_numbers += std::popcount(mask);
+    m_totals.m_values += std::popcount(mask);
+
+#ifdef __AVX2__
+    // eight numbers per step in two independent sets of four lanes. Numbers at unset bits are replaced by 0
+    // for the sum and by +-inf for the comparisons, so the running values are only read by one instruction each
+    const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negInf = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    auto step = [&](size_t i, __m256d &sum, __m256d &low, __m256d &high)
+    {
+        __m256i bits = _mm256_and_si256(_mm256_set1_epi64x(mask >> i), lanes);
+        __m256d isSet = _mm256_castsi256_pd(_mm256_cmpeq_epi64(bits, lanes));
+        __m256d block = _mm256_loadu_pd(numbers + i);
+        sum = _mm256_add_pd(sum, _mm256_and_pd(block, isSet));
+        low = _mm256_min_pd(low, _mm256_blendv_pd(inf, block, isSet));
+        high = _mm256_max_pd(high, _mm256_blendv_pd(negInf, block, isSet));
+    };
+    __m256d sum0 = zero, sum1 = zero;
+    __m256d low0 = _mm256_set1_pd(m_min), low1 = inf;
+    __m256d high0 = _mm256_set1_pd(m_max), high1 = negInf;
+    for (size_t i = 0; i < BLOCK_SIZE; i += 8)
+    {
+        step(i, sum0, low0, high0);
+        step(i + 4, sum1, low1, high1);
+    }
+    alignas(32) double sums[4], lows[4], highs[4];
+    _mm256_store_pd(sums, _mm256_add_pd(sum0, sum1));
+    _mm256_store_pd(lows, _mm256_min_pd(low0, low1));
+    _mm256_store_pd(highs, _mm256_max_pd(high0, high1));
+#else
+    // the same four independent lanes in plain code, simple enough for the compiler to vectorize
+    double sums[4] = {0, 0, 0, 0};
+    double lows[4] = {m_min, m_min, m_min, m_min};
+    double highs[4] = {m_max, m_max, m_max, m_max};
+    for (size_t i = 0; i < BLOCK_SIZE; i += 4)
+    {
+        for (size_t lane = 0; lane < 4; lane++)
+        {
+            bool isSet = (mask >> (i + lane)) & 1;
+            double number = numbers[i + lane];
+            sums[lane] += isSet ? number : 0.0;
+            lows[lane] = isSet && number < lows[lane] ? number : lows[lane];
+            highs[lane] = isSet && number > highs[lane] ? number : highs[lane];
+        }
+    }
+#endif
+    m_totals.m_sum += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    m_min = std::min({m_min, lows[0], lows[1], lows[2], lows[3]});
+    m_max = std::max({m_max, highs[0], highs[1], highs[2], highs[3]});
+}
+
+void CAggregator::addStrings(size_t count)
+{
+    m_totals.m_values += count;
+}
+
+bool CAggregator::isAdditive() const
+{
+    return m_kind == CAggregateKind::SUM || m_kind == CAggregateKind::COUNT || m_kind == CAggregateKind::AVG;
+}
+
+void CAggregator::addTotals(const CTotals &totals)
+{
+    m_totals += totals;
+}
+
+CContent CAggregator::result() const
+{
+    if (m_kind == CAggregateKind::COUNT)
+    {
+        return CContent(double(m_totals.m_values));
+    }
+    if (m_totals.m_numbers == 0)
+    {
+        return CContent();
+    }
+    switch (m_kind)
+    {
+    case CAggregateKind::SUM:
+        return CContent(m_totals.m_sum);
+    case CAggregateKind::MIN:
+        return CContent(m_min);
+    case CAggregateKind::MAX:
+        return CContent(m_max);
+    case CAggregateKind::AVG:
+        return CContent(m_totals.m_sum / m_totals.m_numbers);
+    default:
+        return CContent();
+    }
+}
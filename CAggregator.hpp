@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+#include "CContent.hpp"
+
+// functions that reduce any number of values and ranges to a single value
+enum class CAggregateKind : uint8_t
+{
+    SUM,   // sum of numbers
+    MIN,   // smallest number
+    MAX,   // largest number
+    COUNT, // count of values, numbers and strings alike
+    AVG    // mean of numbers
+};
+
+// sum and counts of a set of values, all the additive functions (see CAggregator::isAdditive) need.
+// Totals of disjoint sets are added together, so they can be kept in prefix sums
+struct CTotals
+{
+    double m_sum = 0;
+    int64_t m_numbers = 0;
+    int64_t m_values = 0;
+    int64_t m_unknown = 0; // values that arent computed yet, totals with some are incomplete
+
+    // totals of a single value, unknown if isKnown is false
+    static CTotals of(const CContent &value, bool isKnown = true);
+
+    CTotals &operator+=(const CTotals &other);
+};
+
+// running state of an aggregate function. Values are added one by one, numbers stored in a contiguous
+// block (see CLiteralColumns) are added a whole block at a time without a branch per value
+class CAggregator
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    explicit CAggregator(CAggregateKind kind) : m_kind(kind){};
+
+    // returns the function called name (in any case), nullopt if there is none
+    static std::optional<CAggregateKind> kindOf(std::string_view name);
+    static const char *nameOf(CAggregateKind kind);
+
+    // numbers are aggregated, strings only counted and empty values skipped
+    void add(const CContent &value);
+
+    // adds numbers[i] for every bit i set in mask, numbers has BLOCK_SIZE items
+    // the values at unset bits are read too, but dont affect the result
+    void addNumbers(const double *numbers, uint64_t mask);
+
+    // counts strings that dont need to be seen one by one
+    void addStrings(size_t count);
+
+    // true if the function is computed from CTotals alone, so values dont need to be seen one by one
+    bool isAdditive() const;
+
+    // adds values summarized by totals, which have to be complete, expects isAdditive()
+    void addTotals(const CTotals &totals);
+
+    // result over everything added, empty if the function needs a number and there was none
+    CContent result() const;
+
+private:
+    CAggregateKind m_kind;
+    CTotals m_totals;
+    double m_min = std::numeric_limits<double>::infinity();
+    double m_max = -std::numeric_limits<double>::infinity();
+};
@@ -0,0 +1,8 @@
+#include "CCellKey.hpp"
+
+CCellKey::CCellKey(const CPos &pos) : CCellKey(pos.m_row, pos.m_col) {}
+
+CPos CCellKey::toPos(bool isAbsRow, bool isAbsCol) const
+{
+    return CPos(getRow(), getCol(), isAbsRow, isAbsCol);
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <compare>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+#include "CPos.hpp"
+
+// offset of a formula from the cell it was written in (see CCell), negative for a copy moved up or left.
+// Both cells lie in the sheet, so an offset always fits
+struct CCellShift
+{
+    int64_t m_rows = 0;
+    int64_t m_cols = 0;
+
+    constexpr CCellShift shiftedBy(int64_t rows, int64_t cols) const
+    {
+        return CCellShift{m_rows + rows, m_cols + cols};
+    }
+
+    constexpr bool operator==(const CCellShift &other) const = default;
+};
+
+// position of a cell packed into one 64 bit integer, row in the upper half and col in the lower half,
+// so keys are ordered the same way as CPos (by row, then by col). Used as the key of all tables of the sheet
+class CCellKey
+{
+public:
+    static constexpr size_t MAX_INDEX = UINT32_MAX;
+
+    constexpr CCellKey() = default;
+
+    // throws invalid_argument if row or col doesnt fit into 32 bits
+    constexpr CCellKey(size_t row, size_t col)
+    {
+        if (row > MAX_INDEX || col > MAX_INDEX)
+        {
+            throw std::invalid_argument("position out of range");
+        }
+        m_key = (static_cast<uint64_t>(row) << 32) | col;
+    }
+
+    // abs flags of pos are dropped
+    explicit CCellKey(const CPos &pos);
+
+    constexpr size_t getRow() const
+    {
+        return m_key >> 32;
+    }
+
+    constexpr size_t getCol() const
+    {
+        return m_key & MAX_INDEX;
+    }
+
+    // key moved by rows and cols, indexes wrap around like unsigned integers
+    constexpr CCellKey shiftedBy(int rows, int cols) const
+    {
+        CCellKey result;
+        result.m_key = (static_cast<uint64_t>(static_cast<uint32_t>(getRow() + rows)) << 32) | static_cast<uint32_t>(getCol() + cols);
+        return result;
+    }
+
+    // position read by a reference to this key in a formula moved by origin, relative indexes are shifted by
+    // origin, absolute ones stay. nullopt if the position is outside of the sheet, such a reference reads nothing
+    constexpr std::optional<CCellKey> resolvedAt(const CCellShift &origin, bool isAbsRow, bool isAbsCol) const
+    {
+        int64_t row = static_cast<int64_t>(getRow()) + (isAbsRow ? 0 : origin.m_rows);
+        int64_t col = static_cast<int64_t>(getCol()) + (isAbsCol ? 0 : origin.m_cols);
+        if (row < 0 || col < 0 || row > static_cast<int64_t>(MAX_INDEX) || col > static_cast<int64_t>(MAX_INDEX))
+        {
+            return std::nullopt;
+        }
+        return CCellKey(row, col);
+    }
+
+    CPos toPos(bool isAbsRow = false, bool isAbsCol = false) const;
+
+    constexpr auto operator<=>(const CCellKey &other) const = default;
+
+    uint64_t m_key = 0;
+};
+
+// finalizer of splitmix64, every input bit affects every output bit, so neighbouring cells spread over the buckets
+constexpr uint64_t mixBits(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+struct CCellKeyHasher
+{
+    std::size_t operator()(const CCellKey &key) const
+    {
+        return mixBits(key.m_key);
+    }
+};
+
+// rectangle of cells, both corners included
+struct CCellRange
+{
+    constexpr CCellRange() = default;
+
+    // corners may be given in any order
+    constexpr CCellRange(const CCellKey &a, const CCellKey &b)
+        : m_first(std::min(a.getRow(), b.getRow()), std::min(a.getCol(), b.getCol())),
+          m_last(std::max(a.getRow(), b.getRow()), std::max(a.getCol(), b.getCol())) {}
+
+    constexpr bool contains(const CCellKey &key) const
+    {
+        return key.getRow() >= m_first.getRow() && key.getRow() <= m_last.getRow() &&
+               key.getCol() >= m_first.getCol() && key.getCol() <= m_last.getCol();
+    }
+
+    constexpr size_t getWidth() const
+    {
+        return m_last.getCol() - m_first.getCol() + 1;
+    }
+
+    constexpr size_t getHeight() const
+    {
+        return m_last.getRow() - m_first.getRow() + 1;
+    }
+
+    constexpr bool operator==(const CCellRange &other) const = default;
+
+    CCellKey m_first; // top left
+    CCellKey m_last;  // bottom right
+};
+
+struct CCellRangeHasher
+{
+    std::size_t operator()(const CCellRange &range) const
+    {
+        return mixBits(range.m_first.m_key ^ mixBits(range.m_last.m_key));
+    }
+};
@@ -0,0 +1,67 @@
+#include "CColumnTotals.hpp"
+#include <algorithm>
+#include <cstdint>
+
+CColumnTotals::CColumnTotals(const std::vector<std::pair<size_t, CTotals>> &items)
+{
+    m_rows.reserve(items.size());
+    m_tree.resize(2 * items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        m_rows.push_back(items[i].first);
+        m_tree[items.size() + i] = items[i].second;
+    }
+    for (size_t i = items.size(); i-- > 1;)
+    {
+        m_tree[i] = m_tree[2 * i];
+        m_tree[i] += m_tree[2 * i + 1];
+    }
+}
+
+bool CColumnTotals::update(size_t row, const CTotals &totals)
+{
+    size_t index = lowerBound(row);
+    if (index == m_rows.size() || m_rows[index] != row)
+    {
+        return false;
+    }
+    // the nodes above the item are added up from their children again
+    size_t i = m_rows.size() + index;
+    m_tree[i] = totals;
+    for (i /= 2; i > 0; i /= 2)
+    {
+        m_tree[i] = m_tree[2 * i];
+        m_tree[i] += m_tree[2 * i + 1];
+    }
+    return true;
+}
+
+CTotals CColumnTotals::query(size_t first, size_t last) const
+{
+    size_t begin = lowerBound(first);
+    size_t end = last == SIZE_MAX ? m_rows.size() : lowerBound(last + 1);
+    // adds the nodes covering items [begin, end) from both sides toward the root
+    CTotals totals;
+    for (begin += m_rows.size(), end += m_rows.size(); begin < end; begin /= 2, end /= 2)
+    {
+        if (begin & 1)
+        {
+            totals += m_tree[begin++];
+        }
+        if (end & 1)
+        {
+            totals += m_tree[--end];
+        }
+    }
+    return totals;
+}
+
+size_t CColumnTotals::size() const
+{
+    return m_rows.size();
+}
+
+size_t CColumnTotals::lowerBound(size_t row) const
+{
+    return std::lower_bound(m_rows.begin(), m_rows.end(), row) - m_rows.begin();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "CAggregator.hpp"
+
+// totals of the items of one column, an item is a cell or a segment of cells identified by its row. Totals of
+// any interval of rows are answered in O(log n) by a segment tree, changed totals of an item are updated in
+// O(log n) as well. Nodes are only ever added up, never subtracted, so a huge or non-finite item doesnt
+// affect the totals of intervals without it. The set of rows is fixed once built, the owner drops the index when an item is added or
+// removed and builds it again when it is needed
+class CColumnTotals
+{
+public:
+    // the index is worth using for ranges at least this tall and at most this wide, others are read directly
+    static constexpr size_t MIN_ROWS = 256;
+    static constexpr size_t MAX_COLS = 16;
+
+    // indexes items given as (row, totals), sorted by row without duplicates
+    explicit CColumnTotals(const std::vector<std::pair<size_t, CTotals>> &items);
+
+    // sets totals of the item at row, returns false if there is none
+    bool update(size_t row, const CTotals &totals);
+
+    // sum of totals of the items in rows [first, last]
+    CTotals query(size_t first, size_t last) const;
+
+    // calls f(row) for every item in rows [first, last] with unknown values
+    template <typename F>
+    void forEachUnknown(size_t first, size_t last, F &&f) const
+    {
+        for (size_t i = lowerBound(first); i < m_rows.size() && m_rows[i] <= last; i++)
+        {
+            if (m_tree[m_rows.size() + i].m_unknown)
+            {
+                f(m_rows[i]);
+            }
+        }
+    }
+
+    size_t size() const;
+
+private:
+    // index of the first item at row or below it
+    size_t lowerBound(size_t row) const;
+
+    std::vector<size_t> m_rows;
+    // with n items, m_tree[n + i] holds item i and m_tree[i] for 0 < i < n the totals of nodes 2i and 2i + 1
+    std::vector<CTotals> m_tree;
+};
@@ -1,13 +1,140 @@
 #include "CContent.hpp"
+#include <utility>
 
-CContent::CContent() : m_value(CValue()) {} // default is monostate
-CContent::CContent(const CValue &value) : m_value(value) {}
+static_assert(sizeof(CContent) == 8);
+
+CContent::CContent() : m_bits(EMPTY_TAG) {} // default is monostate
+
+CContent::CContent(const CValue &value) : CContent()
+{
+    if (std::holds_alternative<double>(value))
+    {
+        *this = CContent(std::get<double>(value));
+    }
+    else if (std::holds_alternative<std::string>(value))
+    {
+        *this = CContent(std::get<std::string>(value));
+    }
+}
+
+CContent::CContent(double value)
+{
+    m_bits = std::isnan(value) ? CANONICAL_NAN : std::bit_cast<uint64_t>(value);
+}
+
+CContent::CContent(std::string value) : m_bits(EMPTY_TAG)
+{
+    CString *string = new CString{{0}, std::move(value)};
+    if (reinterpret_cast<uintptr_t>(string) & TAG_MASK)
+    {
+        delete string;
+        throw std::bad_alloc(); // doesnt fit into the payload
+    }
+    *this = CContent(string);
+}
+
+CContent::CContent(CString *string) : m_bits(STRING_TAG | reinterpret_cast<uintptr_t>(string))
+{
+    retain();
+}
+
+CContent::CContent(const CContent &other) : m_bits(other.m_bits)
+{
+    retain();
+}
+
+CContent::CContent(CContent &&other) noexcept : m_bits(other.m_bits)
+{
+    other.m_bits = EMPTY_TAG;
+}
+
+CContent &CContent::operator=(const CContent &other)
+{
+    other.retain();
+    release();
+    m_bits = other.m_bits;
+    return *this;
+}
+
+CContent &CContent::operator=(CContent &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_bits = other.m_bits;
+        other.m_bits = EMPTY_TAG;
+    }
+    return *this;
+}
+
+CContent::~CContent()
+{
+    release();
+}
+
+CContent::CString *CContent::stringData() const
+{
+    return reinterpret_cast<CString *>(static_cast<uintptr_t>(m_bits & ~TAG_MASK));
+}
+
+bool CContent::ownsString() const
+{
+    return isString() && stringData()->m_refs.load(std::memory_order_acquire) == 1 && !stringData()->m_pool;
+}
+
+void CContent::retain() const
+{
+    if (isString())
+    {
+        stringData()->m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CContent::release()
+{
+    if (isString())
+    {
+        releaseString(stringData());
+    }
+    m_bits = EMPTY_TAG;
+}
+
+void CContent::releaseString(CString *string)
+{
+    if (string->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete string;
+    }
+}
+
+double CContent::getDouble() const
+{
+    return std::bit_cast<double>(m_bits);
+}
+
+const std::string &CContent::getString() const
+{
+    return stringData()->m_value;
+}
+
+CValue CContent::toValue() const
+{
+    if (isDouble())
+    {
+        return CValue(getDouble());
+    }
+    if (isString())
+    {
+        return CValue(getString());
+    }
+    return CValue();
+}
 
 CContent CContent::toExp(const CContent &power) const
 {
     if (this->isDouble() && power.isDouble())
     {
-        return CContent(CValue(std::pow(std::get<double>(m_value), std::get<double>(power.m_value))));
+        return CContent(std::pow(getDouble(), power.getDouble()));
     }
     return CContent();
 }
@@ -16,7 +143,7 @@ CContent CContent::operator-() const
 {
     if (this->isDouble())
     {
-        return CContent(CValue(-(std::get<double>(m_value))));
+        return CContent(-(getDouble()));
     }
     return CContent();
 }
@@ -26,8 +153,8 @@ int CContent::compare(const CContent &other) const
 {
     if (this->isDouble())
     {
-        double x = std::get<double>(m_value);
-        double y = std::get<double>(other.m_value);
+        double x = getDouble();
+        double y = other.getDouble();
         if (x < y)
         {
             return -1;
@@ -43,26 +170,43 @@ int CContent::compare(const CContent &other) const
     }
     else if (this->isString())
     {
-        std::string x = std::get<std::string>(m_value);
-        std::string y = std::get<std::string>(other.m_value);
-        return x.compare(y);
+        return getString().compare(other.getString());
     }
     return 0;
 }
 
+bool CContent::equals(const CContent &other) const
+{
+    if (isString())
+    {
+        if (m_bits == other.m_bits)
+        {
+            return true;
+        }
+        // a pool has only one string of each text
+        const CStringPool *pool = stringData()->m_pool;
+        if (pool && pool == other.stringData()->m_pool)
+        {
+            return false;
+        }
+        return getString() == other.getString();
+    }
+    return compare(other) == 0;
+}
+
 bool CContent::isDouble() const
 {
-    return std::holds_alternative<double>(m_value);
+    return m_bits < EMPTY_TAG;
 }
 
 bool CContent::isString() const
 {
-    return std::holds_alternative<std::string>(m_value);
+    return (m_bits & TAG_MASK) == STRING_TAG;
 }
 
 bool CContent::isMonostate() const
 {
-    return std::holds_alternative<std::monostate>(m_value);
+    return m_bits == EMPTY_TAG;
 }
 
 CContent operator+(const CContent &lhs, const CContent &rhs)
@@ -73,19 +217,19 @@ CContent operator+(const CContent &lhs, const CContent &rhs)
     }
     else if (lhs.isString() && rhs.isString())
     {
-        return CContent(CValue(std::get<std::string>(lhs.m_value) + std::get<std::string>(rhs.m_value)));
+        return CContent(lhs.getString() + rhs.getString());
     }
     else if (lhs.isDouble() && rhs.isDouble())
     {
-        return CContent(CValue(std::get<double>(lhs.m_value) + std::get<double>(rhs.m_value)));
+        return CContent(lhs.getDouble() + rhs.getDouble());
     }
     else if (lhs.isString() && rhs.isDouble())
     {
-        return CContent(CValue(std::get<std::string>(lhs.m_value) + std::to_string(std::get<double>(rhs.m_value))));
+        return CContent(lhs.getString() + std::to_string(rhs.getDouble()));
     }
     else if (lhs.isDouble() && rhs.isString())
     {
-        return CContent(CValue(std::to_string(std::get<double>(lhs.m_value)) + std::get<std::string>(rhs.m_value)));
+        return CContent(std::to_string(lhs.getDouble()) + rhs.getString());
     }
     else
     {
@@ -93,6 +237,24 @@ CContent operator+(const CContent &lhs, const CContent &rhs)
     }
 }
 
+CContent operator+(CContent &&lhs, const CContent &rhs)
+{
+    if (lhs.ownsString() && (rhs.isString() || rhs.isDouble()))
+    {
+        std::string &text = lhs.stringData()->m_value;
+        if (rhs.isString())
+        {
+            text += rhs.getString();
+        }
+        else
+        {
+            text += std::to_string(rhs.getDouble());
+        }
+        return std::move(lhs);
+    }
+    return std::as_const(lhs) + rhs;
+}
+
 CContent operator-(const CContent &lhs, const CContent &rhs)
 {
     if (lhs.isDouble() && rhs.isDouble())
@@ -106,7 +268,7 @@ CContent operator*(const CContent &lhs, const CContent &rhs)
 {
     if (lhs.isDouble() && rhs.isDouble())
     {
-        return CContent(CValue(std::get<double>(lhs.m_value) * std::get<double>(rhs.m_value)));
+        return CContent(lhs.getDouble() * rhs.getDouble());
     }
     return CContent();
 }
@@ -115,11 +277,11 @@ CContent operator/(const CContent &lhs, const CContent &rhs)
 {
     if (lhs.isDouble() && rhs.isDouble())
     {
-        if (std::get<double>(rhs.m_value) == 0)
+        if (rhs.getDouble() == 0)
         {
             return CContent();
         }
-        return CContent(CValue(std::get<double>(lhs.m_value) / std::get<double>(rhs.m_value)));
+        return CContent(lhs.getDouble() / rhs.getDouble());
     }
     return CContent();
 }
@@ -128,7 +290,7 @@ CContent operator<(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) < 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return lhs.compare(rhs) < 0 ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
@@ -137,7 +299,7 @@ CContent operator>(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) > 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return lhs.compare(rhs) > 0 ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
@@ -146,7 +308,7 @@ CContent operator<=(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) <= 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return lhs.compare(rhs) <= 0 ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
@@ -155,7 +317,7 @@ CContent operator>=(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) >= 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return lhs.compare(rhs) >= 0 ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
@@ -164,7 +326,7 @@ CContent operator==(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) == 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return lhs.equals(rhs) ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
@@ -173,14 +335,14 @@ CContent operator!=(const CContent &lhs, const CContent &rhs)
 {
     if ((lhs.isDouble() && rhs.isDouble()) || (lhs.isString() && rhs.isString()))
     {
-        return lhs.compare(rhs) != 0 ? CContent(CValue(1.)) : CContent(CValue(0.));
+        return !lhs.equals(rhs) ? CContent(1.) : CContent(0.);
     }
     return CContent();
 }
 
 void CContent::printString(std::ostream &os) const
 {
-    const std::string original = std::get<std::string>(m_value);
+    const std::string &original = getString();
     for (size_t i = 0; i < original.size(); i++)
     {
         if (original.at(i) == '"')
@@ -198,7 +360,10 @@ std::ostream &operator<<(std::ostream &os, const CContent &content)
 {
     if (content.isDouble())
     {
-        os << std::get<double>(content.m_value);
+        // shortest form that reads back as the same number
+        char buffer[32];
+        std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), content.getDouble());
+        os.write(buffer, result.ptr - buffer);
     }
     else if (content.isString())
     {
@@ -4,17 +4,38 @@
 #include <iostream>
 #include <variant>
 #include <cmath>
+#include <charconv>
+#include <cstdint>
+#include <atomic>
+#include <bit>
+#include <new>
 
 using CValue = std::variant<std::monostate, double, std::string>;
 
-// encapsulates CValue so it is usable in AST
+class CStringPool;
+
+// value used in the AST and by the evaluator, packed into 8 bytes by NaN-boxing. A number is stored as it is
+// (every NaN as one canonical NaN), empty value and string hide in the payload of negative quiet NaNs which
+// no number uses. A string is a pointer to a reference counted string shared by all copies, it is changed
+// only while a single content owns it (see operator+ for rvalues).
+// Converted to the public CValue only by toValue. Strings interned by a CStringPool are compared by pointer
 class CContent
 {
 public:
     CContent();
     CContent(const CValue &value);
+    explicit CContent(double value);
+    explicit CContent(std::string value);
+    CContent(const CContent &other);
+    CContent(CContent &&other) noexcept;
+    CContent &operator=(const CContent &other);
+    CContent &operator=(CContent &&other) noexcept;
+    ~CContent();
+
     // arithmetic
     friend CContent operator+(const CContent &lhs, const CContent &rhs);
+    // appends to the string of lhs in place if lhs is its only owner, so chains of concatenations dont copy
+    friend CContent operator+(CContent &&lhs, const CContent &rhs);
     friend CContent operator-(const CContent &lhs, const CContent &rhs);
     friend CContent operator*(const CContent &lhs, const CContent &rhs);
     friend CContent operator/(const CContent &lhs, const CContent &rhs);
@@ -30,14 +51,50 @@ public:
     friend CContent operator==(const CContent &lhs, const CContent &rhs);
     friend CContent operator!=(const CContent &lhs, const CContent &rhs);
     int compare(const CContent &other) const;
+    bool equals(const CContent &other) const; // for values of the same type, faster than compare for strings
     bool isDouble() const;
     bool isString() const;
     bool isMonostate() const;
+
+    // value of the content, expects it to be of that type
+    double getDouble() const;
+    const std::string &getString() const;
+
+    CValue toValue() const;
+
     // IO
     friend std::ostream &operator<<(std::ostream &os, const CContent &content);
-    CValue m_value;
 
 private:
+    friend class CStringPool;
+
+    struct CString
+    {
+        std::atomic<uint32_t> m_refs;
+        std::string m_value;
+        const CStringPool *m_pool = nullptr; // pool which interned the string, it has no other string with this text
+    };
+
+    static constexpr uint64_t TAG_MASK = 0xffff000000000000;
+    static constexpr uint64_t EMPTY_TAG = 0xfffa000000000000;  // everything below is a number
+    static constexpr uint64_t STRING_TAG = 0xfffb000000000000; // lower 48 bits are CString *
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+    uint64_t m_bits;
+
+    // content sharing string, adds a reference to it
+    explicit CContent(CString *string);
+
+    CString *stringData() const;
+
+    // true if this is a string no other content refers to, and which no pool knows
+    bool ownsString() const;
+    void retain() const;
+    void release();
+
+    // drops a reference of string, frees it with the last one
+    static void releaseString(CString *string);
+
     // saving string as string literal => all " must be doubled
     void printString(std::ostream &os) const;
-};
\ No newline at end of file
+};
@@ -0,0 +1,247 @@
+#include "CLiteralColumns.hpp"
+#include <utility>
+
+static_assert(CLiteralColumns::SEGMENT_ROWS == 64, "a segment has one bit of each mask per row");
+static_assert(CLiteralColumns::SEGMENT_ROWS == CAggregator::BLOCK_SIZE, "numbers of a segment are aggregated as one block");
+
+CCellKey CLiteralColumns::segmentOf(const CCellKey &pos)
+{
+    return CCellKey(pos.getRow() / SEGMENT_ROWS, pos.getCol());
+}
+
+const CLiteralColumns::CSegment *CLiteralColumns::findSegment(const CCellKey &segmentKey) const
+{
+    auto index = m_index.find(segmentKey);
+    return index == m_index.end() ? nullptr : &m_segments[index->second];
+}
+
+CLiteralColumns::CSegment *CLiteralColumns::findSegment(const CCellKey &segmentKey)
+{
+    return const_cast<CSegment *>(std::as_const(*this).findSegment(segmentKey));
+}
+
+bool CLiteralColumns::assign(const CCellKey &pos, const CContent &value)
+{
+    if (!value.isDouble() && !value.isString())
+    {
+        return false;
+    }
+    auto [slot, isNew] = m_index.try_emplace(segmentOf(pos), m_segments.size());
+    if (isNew)
+    {
+        m_segments.emplace_back();
+        m_segments.back().m_key = slot->first;
+    }
+    CSegment &segment = m_segments[slot->second];
+    size_t row = pos.getRow() % SEGMENT_ROWS;
+    uint64_t bit = uint64_t(1) << row;
+    if (!((segment.m_isNumber | segment.m_isString) & bit))
+    {
+        m_size++;
+    }
+    releaseString(segment, row);
+    segment.m_isNumber &= ~bit;
+    if (value.isDouble())
+    {
+        segment.m_numbers[row] = value.getDouble();
+        segment.m_isNumber |= bit;
+        updateIndex(segment, isNew);
+        return true;
+    }
+    uint32_t index;
+    if (m_freeStrings.empty())
+    {
+        index = m_strings.size();
+        m_strings.push_back(value);
+    }
+    else
+    {
+        index = m_freeStrings.back();
+        m_freeStrings.pop_back();
+        m_strings[index] = value;
+    }
+    segment.m_numbers[row] = std::bit_cast<double>(uint64_t(index));
+    segment.m_isString |= bit;
+    updateIndex(segment, isNew);
+    return true;
+}
+
+std::optional<CContent> CLiteralColumns::find(const CCellKey &pos) const
+{
+    const CSegment *segment = findSegment(segmentOf(pos));
+    if (!segment)
+    {
+        return std::nullopt;
+    }
+    size_t row = pos.getRow() % SEGMENT_ROWS;
+    if (!(((segment->m_isNumber | segment->m_isString) >> row) & 1))
+    {
+        return std::nullopt;
+    }
+    return valueAt(*segment, row);
+}
+
+bool CLiteralColumns::contains(const CCellKey &pos) const
+{
+    const CSegment *segment = findSegment(segmentOf(pos));
+    return segment && (((segment->m_isNumber | segment->m_isString) >> (pos.getRow() % SEGMENT_ROWS)) & 1);
+}
+
+bool CLiteralColumns::erase(const CCellKey &pos)
+{
+    auto index = m_index.find(segmentOf(pos));
+    if (index == m_index.end())
+    {
+        return false;
+    }
+    CSegment &segment = m_segments[index->second];
+    size_t row = pos.getRow() % SEGMENT_ROWS;
+    uint64_t bit = uint64_t(1) << row;
+    if (!((segment.m_isNumber | segment.m_isString) & bit))
+    {
+        return false;
+    }
+    releaseString(segment, row);
+    segment.m_isNumber &= ~bit;
+    m_size--;
+    bool isRemoved = !segment.m_isNumber && !segment.m_isString;
+    updateIndex(segment, isRemoved);
+    if (isRemoved)
+    {
+        // the last segment takes the place of the empty one
+        if (&segment != &m_segments.back())
+        {
+            segment = m_segments.back();
+            m_index[segment.m_key] = index->second;
+        }
+        m_segments.pop_back();
+        m_index.erase(index);
+    }
+    return true;
+}
+
+void CLiteralColumns::aggregate(const CCellKey &corner, size_t w, size_t h, CAggregator &aggregator, bool readOnly) const
+{
+    auto addSegment = [&](const CSegment &segment, uint64_t rows)
+    {
+        aggregator.addNumbers(segment.m_numbers.data(), segment.m_isNumber & rows);
+        aggregator.addStrings(std::popcount(segment.m_isString & rows));
+    };
+    if (!m_isIndexed || !aggregator.isAdditive() || w == 0 || w > CColumnTotals::MAX_COLS || h < CColumnTotals::MIN_ROWS)
+    {
+        forEachSegmentIn(corner, w, h, addSegment);
+        return;
+    }
+    size_t lastRow = std::min<size_t>(corner.getRow() + (h - 1), CCellKey::MAX_INDEX);
+    size_t lastCol = std::min<size_t>(corner.getCol() + (w - 1), CCellKey::MAX_INDEX);
+
+    // segments [firstWhole, endWhole) lie in the rectangle as a whole, the parts of the ones around are read
+    size_t firstWhole = (corner.getRow() + SEGMENT_ROWS - 1) / SEGMENT_ROWS;
+    size_t endWhole = (lastRow + 1) / SEGMENT_ROWS;
+    for (size_t col = corner.getCol(); col <= lastCol; col++)
+    {
+        const CColumnTotals *index = indexOf(col, readOnly);
+        if (!index)
+        {
+            forEachSegmentIn(CCellKey(corner.getRow(), col), 1, h, addSegment);
+            continue;
+        }
+        aggregator.addTotals(index->query(firstWhole, endWhole - 1));
+        forEachSegmentIn(CCellKey(corner.getRow(), col), 1, firstWhole * SEGMENT_ROWS - corner.getRow(), addSegment);
+        forEachSegmentIn(CCellKey(endWhole * SEGMENT_ROWS, col), 1, lastRow + 1 - endWhole * SEGMENT_ROWS, addSegment);
+    }
+}
+
+void CLiteralColumns::setIndexed(bool isIndexed)
+{
+    m_isIndexed = isIndexed;
+    m_indexes.clear();
+}
+
+CTotals CLiteralColumns::totalsOf(const CSegment &segment)
+{
+    CTotals totals;
+    for (uint64_t bits = segment.m_isNumber; bits; bits &= bits - 1)
+    {
+        totals.m_sum += segment.m_numbers[std::countr_zero(bits)];
+    }
+    totals.m_numbers = std::popcount(segment.m_isNumber);
+    totals.m_values = std::popcount(segment.m_isNumber | segment.m_isString);
+    return totals;
+}
+
+void CLiteralColumns::updateIndex(const CSegment &segment, bool isAddedOrRemoved)
+{
+    auto index = m_indexes.find(segment.m_key.getCol());
+    if (index == m_indexes.end())
+    {
+        return;
+    }
+    if (isAddedOrRemoved)
+    {
+        m_indexes.erase(index);
+        return;
+    }
+    index->second.update(segment.m_key.getRow(), totalsOf(segment));
+}
+
+const CColumnTotals *CLiteralColumns::indexOf(size_t col, bool readOnly) const
+{
+    auto index = m_indexes.find(col);
+    if (index != m_indexes.end())
+    {
+        return &index->second;
+    }
+    if (readOnly)
+    {
+        return nullptr;
+    }
+    std::vector<std::pair<size_t, CTotals>> items;
+    for (const CSegment &segment : m_segments)
+    {
+        if (segment.m_key.getCol() == col)
+        {
+            items.push_back({segment.m_key.getRow(), totalsOf(segment)});
+        }
+    }
+    std::sort(items.begin(), items.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+    return &m_indexes.emplace(col, CColumnTotals(items)).first->second;
+}
+
+size_t CLiteralColumns::size() const
+{
+    return m_size;
+}
+
+void CLiteralColumns::clear()
+{
+    m_segments.clear();
+    m_index.clear();
+    m_indexes.clear();
+    m_strings.clear();
+    m_freeStrings.clear();
+    m_size = 0;
+}
+
+CContent CLiteralColumns::valueAt(const CSegment &segment, size_t row) const
+{
+    if ((segment.m_isNumber >> row) & 1)
+    {
+        return CContent(segment.m_numbers[row]);
+    }
+    return m_strings[std::bit_cast<uint64_t>(segment.m_numbers[row])];
+}
+
+void CLiteralColumns::releaseString(CSegment &segment, size_t row)
+{
+    uint64_t bit = uint64_t(1) << row;
+    if (!(segment.m_isString & bit))
+    {
+        return;
+    }
+    uint32_t index = std::bit_cast<uint64_t>(segment.m_numbers[row]);
+    m_strings[index] = CContent();
+    m_freeStrings.push_back(index);
+    segment.m_isString &= ~bit;
+}
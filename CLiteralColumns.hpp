@@ -0,0 +1,165 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CAggregator.hpp"
+#include "CColumnTotals.hpp"
+#include "CCellKey.hpp"
+#include "CContent.hpp"
+
+// values of cells that hold a plain number or string, stored by column. Each column is split into segments
+// of SEGMENT_ROWS rows, allocated on demand. A segment keeps its numbers in one contiguous array and marks
+// which rows hold a number and which a string, the strings themselves live in a list shared by the table.
+// The list holds the string contents as they are given, so interned strings stay shared. All segments are
+// kept side by side in one vector, so a column filled from top to bottom is read in a single sequential pass
+class CLiteralColumns
+{
+public:
+    static constexpr size_t SEGMENT_ROWS = 64;
+
+    // stores value at pos, returns false and stores nothing if value is neither a number nor a string
+    bool assign(const CCellKey &pos, const CContent &value);
+
+    // returns value at pos, nullopt if there is no literal at pos
+    std::optional<CContent> find(const CCellKey &pos) const;
+
+    bool contains(const CCellKey &pos) const;
+
+    // removes value at pos, returns false if there was none
+    bool erase(const CCellKey &pos);
+
+    size_t size() const;
+    void clear();
+
+    // calls f(pos, value) for every stored value, in no particular order
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (const CSegment &segment : m_segments)
+        {
+            visit(segment, ~uint64_t(0), f);
+        }
+    }
+
+    // calls f(pos, value) for every value in the rectangle of h rows and w cols with top left cell corner,
+    // in no particular order, the parts of the rectangle beyond the last addressable row or col are ignored
+    template <typename F>
+    void forEachIn(const CCellKey &corner, size_t w, size_t h, F &&f) const
+    {
+        forEachSegmentIn(corner, w, h, [&](const CSegment &segment, uint64_t rows)
+                         { visit(segment, rows, f); });
+    }
+
+    // adds all values in the rectangle (see forEachIn) to aggregator, numbers a segment at a time. With indexes
+    // enabled, an additive aggregator gets the totals of whole segments of a tall rectangle from the index of
+    // each column, which is built on first use unless readOnly is set, then the column is read directly
+    void aggregate(const CCellKey &corner, size_t w, size_t h, CAggregator &aggregator, bool readOnly = false) const;
+
+    // turns per column indexes of segment totals (see CColumnTotals) on or off, they are off by default
+    void setIndexed(bool isIndexed);
+
+private:
+    struct CSegment
+    {
+        // string rows hold the index of their string in m_strings instead of a number
+        std::array<double, SEGMENT_ROWS> m_numbers = {}; // zeroed, CAggregator reads whole segments including the empty rows
+        uint64_t m_isNumber = 0;
+        uint64_t m_isString = 0;
+        CCellKey m_key; // (row / SEGMENT_ROWS, col)
+    };
+
+    // calls f for values of the rows of the segment set in rows
+    template <typename F>
+    void visit(const CSegment &segment, uint64_t rows, F &f) const
+    {
+        uint64_t bits = (segment.m_isNumber | segment.m_isString) & rows;
+        while (bits)
+        {
+            size_t row = std::countr_zero(bits);
+            bits &= bits - 1;
+            CCellKey pos(segment.m_key.getRow() * SEGMENT_ROWS + row, segment.m_key.getCol());
+            f(pos, valueAt(segment, row));
+        }
+    }
+
+    // calls f(segment, rows) for every segment overlapping the rectangle (see forEachIn), rows has
+    // a bit set for each row of the segment inside it. Looks up the segments the rectangle overlaps, or goes
+    // through all segments if there are no more of them
+    template <typename F>
+    void forEachSegmentIn(const CCellKey &corner, size_t w, size_t h, F &&f) const
+    {
+        if (w == 0 || h == 0)
+        {
+            return;
+        }
+        size_t lastRow = std::min<size_t>(corner.getRow() + (h - 1), CCellKey::MAX_INDEX);
+        size_t lastCol = std::min<size_t>(corner.getCol() + (w - 1), CCellKey::MAX_INDEX);
+        size_t firstSegment = corner.getRow() / SEGMENT_ROWS;
+        size_t lastSegment = lastRow / SEGMENT_ROWS;
+        auto rowsOf = [&](size_t segmentRow)
+        {
+            size_t firstRow = segmentRow * SEGMENT_ROWS;
+            size_t begin = std::max(corner.getRow(), firstRow) - firstRow;
+            size_t end = std::min(lastRow, firstRow + SEGMENT_ROWS - 1) - firstRow + 1;
+            return (end - begin == SEGMENT_ROWS ? ~uint64_t(0) : (uint64_t(1) << (end - begin)) - 1) << begin;
+        };
+        if ((lastCol - corner.getCol() + 1) >= m_segments.size() / (lastSegment - firstSegment + 1))
+        {
+            for (const CSegment &segment : m_segments)
+            {
+                if (segment.m_key.getCol() >= corner.getCol() && segment.m_key.getCol() <= lastCol &&
+                    segment.m_key.getRow() >= firstSegment && segment.m_key.getRow() <= lastSegment)
+                {
+                    f(segment, rowsOf(segment.m_key.getRow()));
+                }
+            }
+            return;
+        }
+        for (size_t col = corner.getCol(); col <= lastCol; col++)
+        {
+            for (size_t segmentRow = firstSegment; segmentRow <= lastSegment; segmentRow++)
+            {
+                if (const CSegment *segment = findSegment(CCellKey(segmentRow, col)))
+                {
+                    f(*segment, rowsOf(segmentRow));
+                }
+            }
+        }
+    }
+
+    static CCellKey segmentOf(const CCellKey &pos);
+
+    static CTotals totalsOf(const CSegment &segment);
+
+    // keeps the index of segment's column up to date after segment changed, an index whose column gained
+    // or lost segment is dropped instead
+    void updateIndex(const CSegment &segment, bool isAddedOrRemoved);
+
+    // returns index of col, building it if needed, nullptr if it isnt built and readOnly is set
+    const CColumnTotals *indexOf(size_t col, bool readOnly) const;
+
+    // returns segment with key, nullptr if it isnt allocated
+    const CSegment *findSegment(const CCellKey &segmentKey) const;
+    CSegment *findSegment(const CCellKey &segmentKey);
+
+    CContent valueAt(const CSegment &segment, size_t row) const;
+
+    // frees the string of row if it holds one
+    void releaseString(CSegment &segment, size_t row);
+
+    std::vector<CSegment> m_segments;                                   // in order of allocation, a freed one is replaced by the last
+    std::unordered_map<CCellKey, uint32_t, CCellKeyHasher> m_index;     // segment key -> index in m_segments
+    std::vector<CContent> m_strings;
+    std::vector<uint32_t> m_freeStrings; // indexes of unused slots of m_strings
+    size_t m_size = 0;
+
+    bool m_isIndexed = false;
+    mutable std::unordered_map<size_t, CColumnTotals> m_indexes; // col -> totals of its segments by segment row
+};
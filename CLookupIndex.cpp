@@ -0,0 +1,186 @@
+#include "CLookupIndex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace
+{
+    void addTo(CLookupIndex::CMatch &match, size_t offset)
+    {
+        match.m_first = std::min(match.m_first, offset);
+        match.m_count++;
+    }
+}
+
+void CLookupIndex::add(const CContent &value, size_t offset)
+{
+    if (value.isDouble() && std::isnan(value.getDouble()))
+    {
+        return; // equal to nothing
+    }
+    if (value.isDouble())
+    {
+        addTo(m_numbers[value.getDouble() == 0 ? 0.0 : value.getDouble()], offset);
+        m_size++;
+    }
+    else if (value.isString())
+    {
+        addTo(m_strings[value.getString()], offset);
+        m_size++;
+    }
+}
+
+CLookupIndex::CMatch CLookupIndex::find(const CContent &key) const
+{
+    if (key.isDouble())
+    {
+        auto found = m_numbers.find(key.getDouble() == 0 ? 0.0 : key.getDouble());
+        return found == m_numbers.end() ? CMatch() : found->second;
+    }
+    if (key.isString())
+    {
+        auto found = m_strings.find(key.getString());
+        return found == m_strings.end() ? CMatch() : found->second;
+    }
+    return CMatch();
+}
+
+size_t CLookupIndex::size() const
+{
+    return m_size;
+}
+
+CLookupCache::CLookupCache(const CLookupCache &) {}
+
+CLookupCache::CLookupCache(CLookupCache &&other) noexcept
+    : m_indexes(std::move(other.m_indexes)), m_blocks(std::move(other.m_blocks)), m_wideRanges(std::move(other.m_wideRanges)),
+      m_cells(other.m_cells)
+{
+    other.m_cells = 0;
+}
+
+CLookupCache &CLookupCache::operator=(const CLookupCache &other)
+{
+    if (this != &other)
+    {
+        clear();
+    }
+    return *this;
+}
+
+CLookupCache &CLookupCache::operator=(CLookupCache &&other) noexcept
+{
+    m_indexes = std::move(other.m_indexes);
+    m_blocks = std::move(other.m_blocks);
+    m_wideRanges = std::move(other.m_wideRanges);
+    m_cells = other.m_cells;
+    other.m_cells = 0;
+    return *this;
+}
+
+std::optional<CLookupIndex::CMatch> CLookupCache::find(const CCellRange &range, const CContent &key) const
+{
+    std::shared_lock lock(m_mutex);
+    auto found = m_indexes.find(range);
+    if (found == m_indexes.end())
+    {
+        return std::nullopt;
+    }
+    return found->second.find(key);
+}
+
+void CLookupCache::insert(const CCellRange &range, CLookupIndex index)
+{
+    std::unique_lock lock(m_mutex);
+    if (m_indexes.contains(range))
+    {
+        return; // built by another thread in the meantime
+    }
+    if (m_cells + index.size() > MAX_CELLS)
+    {
+        m_indexes.clear();
+        m_blocks.clear();
+        m_wideRanges.clear();
+        m_cells = 0;
+    }
+    m_cells += index.size();
+    m_indexes.emplace(range, std::move(index));
+    if (isWide(range))
+    {
+        m_wideRanges.push_back(range);
+        return;
+    }
+    for (size_t block = range.m_first.getCol() / BLOCK_COLS; block <= range.m_last.getCol() / BLOCK_COLS; block++)
+    {
+        m_blocks[block].push_back(range);
+    }
+}
+
+void CLookupCache::drop(const CCellKey &pos)
+{
+    std::unique_lock lock(m_mutex);
+    std::vector<CCellRange> containing;
+    for (const auto &range : m_wideRanges)
+    {
+        if (range.contains(pos))
+        {
+            containing.push_back(range);
+        }
+    }
+    auto block = m_blocks.find(pos.getCol() / BLOCK_COLS);
+    if (block != m_blocks.end())
+    {
+        for (const auto &range : block->second)
+        {
+            if (range.contains(pos))
+            {
+                containing.push_back(range);
+            }
+        }
+    }
+    for (const auto &range : containing)
+    {
+        erase(range);
+    }
+}
+
+size_t CLookupCache::size() const
+{
+    std::shared_lock lock(m_mutex);
+    return m_indexes.size();
+}
+
+void CLookupCache::clear()
+{
+    std::unique_lock lock(m_mutex);
+    m_indexes.clear();
+    m_blocks.clear();
+    m_wideRanges.clear();
+    m_cells = 0;
+}
+
+bool CLookupCache::isWide(const CCellRange &range)
+{
+    return range.m_last.getCol() / BLOCK_COLS - range.m_first.getCol() / BLOCK_COLS >= MAX_BLOCKS;
+}
+
+void CLookupCache::erase(const CCellRange &range)
+{
+    auto index = m_indexes.find(range);
+    m_cells -= index->second.size();
+    m_indexes.erase(index);
+    if (isWide(range))
+    {
+        std::erase(m_wideRanges, range);
+        return;
+    }
+    for (size_t block = range.m_first.getCol() / BLOCK_COLS; block <= range.m_last.getCol() / BLOCK_COLS; block++)
+    {
+        auto ranges = m_blocks.find(block);
+        std::erase(ranges->second, range);
+        if (ranges->second.empty())
+        {
+            m_blocks.erase(ranges);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CCellKey.hpp"
+#include "CContent.hpp"
+
+// functions that find a value among the cells of a range, only exact matches are supported
+enum class CLookupKind : uint8_t
+{
+    VLOOKUP, // VLOOKUP(key, range, n[, 0]) is the n-th cell of the first row of range starting with key
+    MATCH,   // MATCH(key, range[, 0]) is the position of key in a range of one row or col, starting from 1
+    COUNTIF  // COUNTIF(range, key) is the count of cells of range equal to key
+};
+
+// hash index of the values of a range, built by adding every cell once. Cells are identified by their offset
+// in the range, rows one after another. Numbers and strings match when they are equal (as by =), empty cells
+// and empty keys never match
+class CLookupIndex
+{
+public:
+    struct CMatch
+    {
+        size_t m_first = SIZE_MAX; // smallest offset of a matching cell
+        size_t m_count = 0;
+    };
+
+    // adds value of the cell at offset, any order of offsets
+    void add(const CContent &value, size_t offset);
+
+    // returns the cells matching key, count 0 if there are none
+    CMatch find(const CContent &key) const;
+
+    // count of cells added with a number or string
+    size_t size() const;
+
+private:
+    std::unordered_map<double, CMatch> m_numbers; // 0 and -0 are both stored as 0
+    std::unordered_map<std::string, CMatch> m_strings;
+    size_t m_size = 0;
+};
+
+// indexes of ranges read by lookups, the owner drops the indexes of the ranges containing a cell whenever
+// its value changes. Safe to use from several threads, a copy starts empty
+class CLookupCache
+{
+public:
+    // once the indexes hold more cells, all of them are dropped before adding another one
+    static constexpr size_t MAX_CELLS = 1 << 22;
+
+    CLookupCache() = default;
+    CLookupCache(const CLookupCache &other);
+    CLookupCache(CLookupCache &&other) noexcept;
+    CLookupCache &operator=(const CLookupCache &other);
+    CLookupCache &operator=(CLookupCache &&other) noexcept;
+
+    // returns the cells of range matching key, nullopt if range isnt indexed
+    std::optional<CLookupIndex::CMatch> find(const CCellRange &range, const CContent &key) const;
+
+    // stores index of range, unless it is indexed already
+    void insert(const CCellRange &range, CLookupIndex index);
+
+    // drops indexes of all ranges containing pos
+    void drop(const CCellKey &pos);
+
+    size_t size() const;
+    void clear();
+
+private:
+    // ranges are listed under each block of BLOCK_COLS columns they overlap, so the ones containing a cell
+    // are found without going through all of them. Ranges over more than MAX_BLOCKS blocks are kept in
+    // m_wideRanges instead, checked for every cell
+    static constexpr size_t BLOCK_COLS = 64;
+    static constexpr size_t MAX_BLOCKS = 64;
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<CCellRange, CLookupIndex, CCellRangeHasher> m_indexes;
+    std::unordered_map<size_t, std::vector<CCellRange>> m_blocks;
+    std::vector<CCellRange> m_wideRanges;
+    size_t m_cells = 0;
+
+    static bool isWide(const CCellRange &range);
+    void erase(const CCellRange &range);
+};
@@ -0,0 +1,75 @@
+#include "CNodeArena.hpp"
+#include <cstdint>
+
+CNodeArena::~CNodeArena()
+{
+    for (void *block : m_blocks)
+    {
+        ::operator delete(block, std::align_val_t(BLOCK_SIZE));
+    }
+}
+
+void *CNodeArena::allocate(size_t size)
+{
+    size_t sizeClass = (size + ALIGNMENT - 1) / ALIGNMENT;
+    size = sizeClass * ALIGNMENT;
+    m_liveBytes += size;
+    m_liveNodes++;
+
+    if (m_free[sizeClass])
+    {
+        CFreeNode *reused = m_free[sizeClass];
+        m_free[sizeClass] = reused->m_next;
+        m_freeBytes -= size;
+        return reused;
+    }
+
+    if (static_cast<size_t>(m_end[sizeClass] - m_next[sizeClass]) < size)
+    {
+        void *block = ::operator new(BLOCK_SIZE, std::align_val_t(BLOCK_SIZE));
+        m_blocks.push_back(block);
+        new (block) CBlockHeader{sizeClass};
+        m_next[sizeClass] = static_cast<std::byte *>(block) + sizeof(CBlockHeader);
+        m_end[sizeClass] = static_cast<std::byte *>(block) + BLOCK_SIZE;
+    }
+    void *result = m_next[sizeClass];
+    m_next[sizeClass] += size;
+    return result;
+}
+
+void CNodeArena::deallocate(void *ptr)
+{
+    uintptr_t blockStart = reinterpret_cast<uintptr_t>(ptr) & ~(BLOCK_SIZE - 1);
+    size_t sizeClass = reinterpret_cast<const CBlockHeader *>(blockStart)->m_sizeClass;
+    m_liveBytes -= sizeClass * ALIGNMENT;
+    m_liveNodes--;
+
+    CFreeNode *freed = static_cast<CFreeNode *>(ptr);
+    freed->m_next = m_free[sizeClass];
+    m_free[sizeClass] = freed;
+    m_freeBytes += sizeClass * ALIGNMENT;
+
+    if (m_released && m_liveNodes == 0)
+    {
+        delete this;
+    }
+}
+
+size_t CNodeArena::liveBytes() const
+{
+    return m_liveBytes;
+}
+
+size_t CNodeArena::freeBytes() const
+{
+    return m_freeBytes;
+}
+
+void CNodeArena::release()
+{
+    m_released = true;
+    if (m_liveNodes == 0)
+    {
+        delete this;
+    }
+}
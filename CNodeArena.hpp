@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <array>
+#include <new>
+
+// memory for AST nodes of one spreadsheet. Every block serves nodes of one size class, nodes are bump
+// allocated from it and freed nodes are kept in a free list of their size class and reused. Blocks are
+// aligned to their size, so a freed node finds its size class in the header of the block it lies in
+class CNodeArena
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t ALIGNMENT = 16;
+    static constexpr size_t MAX_NODE_SIZE = 256;
+
+    CNodeArena() = default;
+    CNodeArena(const CNodeArena &other) = delete;
+    CNodeArena &operator=(const CNodeArena &other) = delete;
+    ~CNodeArena();
+
+    void *allocate(size_t size);
+    void deallocate(void *ptr);
+
+    // bytes held by nodes that are alive / sitting in free lists
+    size_t liveBytes() const;
+    size_t freeBytes() const;
+
+    // the owner gives up the arena, it is deleted right away or once its last node is freed
+    void release();
+
+private:
+    struct CFreeNode
+    {
+        CFreeNode *m_next;
+    };
+
+    struct alignas(ALIGNMENT) CBlockHeader
+    {
+        size_t m_sizeClass;
+    };
+
+    static constexpr size_t SIZE_CLASSES = MAX_NODE_SIZE / ALIGNMENT + 1; // size class = size / ALIGNMENT
+
+    std::vector<void *> m_blocks;
+    std::array<std::byte *, SIZE_CLASSES> m_next = {}; // first unused byte of the newest block of each size class
+    std::array<std::byte *, SIZE_CLASSES> m_end = {};
+    std::array<CFreeNode *, SIZE_CLASSES> m_free = {};
+    size_t m_liveBytes = 0;
+    size_t m_freeBytes = 0;
+    size_t m_liveNodes = 0;
+    bool m_released = false;
+};
+
+struct CNodeArenaRelease
+{
+    void operator()(CNodeArena *arena) const
+    {
+        arena->release();
+    }
+};
+
+// owning pointer to an arena, the arena outlives the pointer if some of its nodes are still in use
+using CNodeArenaPtr = std::unique_ptr<CNodeArena, CNodeArenaRelease>;
+
+// deleter for nodes created in an arena, without arena (nullptr) the node was created by new
+template <typename T>
+struct CArenaDeleter
+{
+    CNodeArena *m_arena = nullptr;
+
+    void operator()(T *node) const
+    {
+        if (!m_arena)
+        {
+            delete node;
+            return;
+        }
+        node->~T();
+        m_arena->deallocate(node);
+    }
+};
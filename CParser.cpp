@@ -0,0 +1,355 @@
+#include "CParser.hpp"
+#include <charconv>
+
+namespace
+{
+    bool isLetter(char ch)
+    {
+        return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+    }
+
+    bool isDigit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+}
+
+void CParser::parse(std::string_view input, CExprBuilder &builder)
+{
+    if (input.empty() || input[0] != '=')
+    {
+        // a plain value is a number only if all of it is one, words like "inf" stay strings
+        size_t first = !input.empty() && input[0] == '-' ? 1 : 0;
+        double value;
+        auto [end, error] = std::from_chars(input.data(), input.data() + input.size(), value);
+        if (first < input.size() && (isDigit(input[first]) || input[first] == '.') && error == std::errc() && end == input.data() + input.size())
+        {
+            builder.valNumber(value);
+        }
+        else
+        {
+            builder.valString(std::string(input));
+        }
+        return;
+    }
+    CParser parser(input, builder);
+    parser.m_at = 1;
+    parser.parseCompare();
+    parser.skipSpaces();
+    if (!parser.atEnd())
+    {
+        parser.fail("unexpected char after expression");
+    }
+}
+
+void CParser::parseCompare()
+{
+    parseSum();
+    while (true)
+    {
+        // longer operators first, so "<=" isnt read as "<"
+        if (accept("<>"))
+        {
+            parseSum();
+            m_builder.opNe();
+        }
+        else if (accept("<="))
+        {
+            parseSum();
+            m_builder.opLe();
+        }
+        else if (accept(">="))
+        {
+            parseSum();
+            m_builder.opGe();
+        }
+        else if (accept("<"))
+        {
+            parseSum();
+            m_builder.opLt();
+        }
+        else if (accept(">"))
+        {
+            parseSum();
+            m_builder.opGt();
+        }
+        else if (accept("="))
+        {
+            parseSum();
+            m_builder.opEq();
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+void CParser::parseSum()
+{
+    parseProduct();
+    while (true)
+    {
+        if (accept("+"))
+        {
+            parseProduct();
+            m_builder.opAdd();
+        }
+        else if (accept("-"))
+        {
+            parseProduct();
+            m_builder.opSub();
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+void CParser::parseProduct()
+{
+    parseUnary();
+    while (true)
+    {
+        if (accept("*"))
+        {
+            parseUnary();
+            m_builder.opMul();
+        }
+        else if (accept("/"))
+        {
+            parseUnary();
+            m_builder.opDiv();
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+void CParser::parseUnary()
+{
+    if (accept("-"))
+    {
+        parseUnary();
+        m_builder.opNeg();
+        return;
+    }
+    parsePower();
+}
+
+void CParser::parsePower()
+{
+    parsePrimary();
+    while (accept("^"))
+    {
+        parseExponent();
+        m_builder.opPow();
+    }
+}
+
+void CParser::parseExponent()
+{
+    if (accept("-"))
+    {
+        parseExponent();
+        m_builder.opNeg();
+        return;
+    }
+    parsePrimary();
+}
+
+void CParser::parsePrimary()
+{
+    skipSpaces();
+    if (atEnd())
+    {
+        fail("missing operand");
+    }
+    char ch = m_input[m_at];
+    if (ch == '(')
+    {
+        m_at++;
+        parseCompare();
+        expect(")");
+    }
+    else if (ch == '"')
+    {
+        parseString();
+    }
+    else if (isDigit(ch) || ch == '.')
+    {
+        parseNumber();
+    }
+    else if (size_t length = referenceLength(); length > 0 && (m_at + length == m_input.size() || m_input[m_at + length] != '('))
+    {
+        size_t begin = m_at;
+        m_at += length;
+        if (!atEnd() && m_input[m_at] == ':')
+        {
+            m_at++;
+            size_t second = referenceLength();
+            if (second == 0)
+            {
+                fail("missing end of range");
+            }
+            m_at += second;
+            m_builder.valRange(std::string(m_input.substr(begin, m_at - begin)));
+        }
+        else
+        {
+            m_builder.valReference(std::string(m_input.substr(begin, length)));
+        }
+    }
+    else if (isLetter(ch))
+    {
+        size_t begin = m_at;
+        while (!atEnd() && (isLetter(m_input[m_at]) || isDigit(m_input[m_at]) || m_input[m_at] == '_'))
+        {
+            m_at++;
+        }
+        parseCall(m_input.substr(begin, m_at - begin));
+    }
+    else
+    {
+        fail("unknown char in expression");
+    }
+}
+
+void CParser::parseNumber()
+{
+    double value;
+    auto [end, error] = std::from_chars(m_input.data() + m_at, m_input.data() + m_input.size(), value);
+    if (error != std::errc())
+    {
+        fail("invalid number");
+    }
+    m_at = end - m_input.data();
+    m_builder.valNumber(value);
+}
+
+void CParser::parseString()
+{
+    // text between quotes, a doubled quote stands for one quote
+    size_t begin = ++m_at;
+    bool hasQuotes = false;
+    while (true)
+    {
+        size_t quote = m_input.find('"', m_at);
+        if (quote == std::string_view::npos)
+        {
+            fail("unterminated string");
+        }
+        m_at = quote + 1;
+        if (atEnd() || m_input[m_at] != '"')
+        {
+            break;
+        }
+        hasQuotes = true;
+        m_at++;
+    }
+    std::string_view raw = m_input.substr(begin, m_at - 1 - begin);
+    if (!hasQuotes)
+    {
+        m_builder.valString(std::string(raw));
+        return;
+    }
+    std::string text;
+    text.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        text += raw[i];
+        if (raw[i] == '"')
+        {
+            i++;
+        }
+    }
+    m_builder.valString(std::move(text));
+}
+
+void CParser::parseCall(std::string_view name)
+{
+    expect("(");
+    int paramCount = 0;
+    if (!accept(")"))
+    {
+        do
+        {
+            parseCompare();
+            paramCount++;
+        } while (accept(","));
+        expect(")");
+    }
+    m_builder.funcCall(std::string(name), paramCount);
+}
+
+size_t CParser::referenceLength() const
+{
+    if (m_input.substr(m_at).starts_with(OFF_SHEET))
+    {
+        return OFF_SHEET.size();
+    }
+    size_t i = m_at;
+    if (i < m_input.size() && m_input[i] == '$')
+    {
+        i++;
+    }
+    size_t letters = i;
+    while (i < m_input.size() && isLetter(m_input[i]))
+    {
+        i++;
+    }
+    if (i == letters)
+    {
+        return 0;
+    }
+    if (i < m_input.size() && m_input[i] == '$')
+    {
+        i++;
+    }
+    size_t digits = i;
+    while (i < m_input.size() && isDigit(m_input[i]))
+    {
+        i++;
+    }
+    return i == digits ? 0 : i - m_at;
+}
+
+bool CParser::accept(std::string_view token)
+{
+    skipSpaces();
+    if (m_input.substr(m_at).starts_with(token))
+    {
+        m_at += token.size();
+        return true;
+    }
+    return false;
+}
+
+void CParser::expect(std::string_view token)
+{
+    if (!accept(token))
+    {
+        fail("missing token");
+    }
+}
+
+void CParser::skipSpaces()
+{
+    while (!atEnd() && (m_input[m_at] == ' ' || m_input[m_at] == '\t' || m_input[m_at] == '\n' || m_input[m_at] == '\r'))
+    {
+        m_at++;
+    }
+}
+
+bool CParser::atEnd() const
+{
+    return m_at == m_input.size();
+}
+
+void CParser::fail(const char *message) const
+{
+    throw std::invalid_argument(std::string(message) + " at " + std::to_string(m_at));
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+#include "expression.h"
+
+// recursive descent parser of cell contents, reports what it reads to a CExprBuilder in postfix order the same
+// way parseExpression of the provided library does. Reads straight from the input, strings are only built
+// for the builder's arguments (references and ranges are short enough to need no allocation)
+//
+// contents  ::= '=' compare | number | text
+// compare   ::= sum { ('=' | '<>' | '<' | '<=' | '>' | '>=') sum }
+// sum       ::= product { ('+' | '-') product }
+// product   ::= unary { ('*' | '/') unary }
+// unary     ::= '-' unary | power
+// power     ::= primary { '^' exponent }
+// exponent  ::= '-' exponent | primary
+// primary   ::= number | '"' text '"' | reference [':' reference] | name '(' [compare {',' compare}] ')' | '(' compare ')'
+// reference ::= [$]letters[$]digits | '#REF!'
+class CParser
+{
+public:
+    // written in place of a reference to a cell outside of the sheet, reported to the builder as a reference
+    static constexpr std::string_view OFF_SHEET = "#REF!";
+
+    // parses contents of a cell, throws invalid_argument if it starts with '=' and isnt a valid formula
+    static void parse(std::string_view input, CExprBuilder &builder);
+
+private:
+    CParser(std::string_view input, CExprBuilder &builder) : m_input(input), m_builder(builder){};
+
+    void parseCompare();
+    void parseSum();
+    void parseProduct();
+    void parseUnary();
+    void parsePower();
+    void parseExponent();
+    void parsePrimary();
+    void parseNumber();
+    void parseString();
+    void parseCall(std::string_view name);
+
+    // length of [$]letters[$]digits or OFF_SHEET at the current position, 0 if there is no reference
+    size_t referenceLength() const;
+
+    // skips whitespace, then consumes token if the input continues with it
+    bool accept(std::string_view token);
+    void expect(std::string_view token);
+    void skipSpaces();
+    bool atEnd() const;
+
+    [[noreturn]] void fail(const char *message) const;
+
+    std::string_view m_input;
+    size_t m_at = 0;
+    CExprBuilder &m_builder;
+};
@@ -1,23 +1,87 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
-#include <iostream>
-#include <sstream>
-#include <vector>
-#include <cmath>
 #include <stdexcept>
-#include <functional>
-#include <unordered_map>
+#include <cstdint>
 
 class CPos
 {
 public:
-    CPos(std::string_view str);
-    size_t m_row;
-    size_t m_col;
+    // parses [$]letters[$]digits in a single pass without allocating, letters are case insensitive,
+    // col A is 0. Throws invalid_argument if str isnt a position or its indexes dont fit into size_t
+    constexpr CPos(std::string_view str)
+    {
+        size_t i = 0;
+        if (i < str.size() && str[i] == '$')
+        {
+            m_isAbsCol = true;
+            i++;
+        }
+        size_t letters = i;
+        size_t col = 0;
+        for (; i < str.size() && isLetter(str[i]); i++)
+        {
+            size_t digit = (str[i] | 0x20) - 'a' + 1;
+            if (col > (SIZE_MAX - digit) / 26)
+            {
+                throw std::invalid_argument("COL out of range");
+            }
+            col = col * 26 + digit;
+        }
+        if (i == letters || i == str.size() || (!isDigit(str[i]) && str[i] != '$'))
+        {
+            throw std::invalid_argument("unknown char in COL");
+        }
+        m_col = col - 1;
+
+        if (str[i] == '$')
+        {
+            m_isAbsRow = true;
+            i++;
+        }
+        if (i == str.size())
+        {
+            throw std::invalid_argument("missing ROW");
+        }
+        size_t row = 0;
+        for (; i < str.size(); i++)
+        {
+            if (!isDigit(str[i]))
+            {
+                throw std::invalid_argument("unknown char in ROW");
+            }
+            size_t digit = str[i] - '0';
+            if (row > (SIZE_MAX - digit) / 10)
+            {
+                throw std::invalid_argument("ROW out of range");
+            }
+            row = row * 10 + digit;
+        }
+        m_row = row;
+    }
+    CPos(size_t row, size_t col, bool isAbsRow = false, bool isAbsCol = false);
+    size_t m_row = 0;
+    size_t m_col = 0;
     bool m_isAbsRow = false;
     bool m_isAbsCol = false;
 
+    // longest column id, 26^14 > 2^64
+    static constexpr size_t MAX_COL_LETTERS = 14;
+
+    // writes letters of col id right to left, ending just before end, returns pointer to the first letter
+    static constexpr char *formatCol(size_t col, char *end)
+    {
+        // bijective base 26, A..Z are digits 1..26, so col + 1 always has at least one letter
+        size_t num = col;
+        do
+        {
+            *--end = 'A' + num % 26;
+            num = num / 26;
+        } while (num-- > 0);
+        return end;
+    }
+
     void shiftBy(int x, int y);
     bool operator==(const CPos &other) const;
     bool operator<(const CPos &other) const;
@@ -25,19 +89,12 @@ public:
     void print(std::ostream &os) const;
 
 private:
-    void parseCol(std::istringstream &input);
-    void parseRow(std::istringstream &input);
-    size_t letterToInt(char ch) const;
-    char intToLetter(int i) const;
-    size_t getValue(const std::vector<size_t> &digits, const size_t base) const; // calculates the numerical value of col id
-    std::string getCol() const;
-};
-
-struct CPosHasher
-{
-    std::size_t operator()(const CPos &pos) const
+    static constexpr bool isLetter(char ch)
     {
-        using std::hash;
-        return ((hash<size_t>()(pos.m_row) ^ (hash<size_t>()(pos.m_col) << 1)) >> 1);
+        return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
     }
-};
\ No newline at end of file
+    static constexpr bool isDigit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+};
@@ -0,0 +1,261 @@
+#include "CProgram.hpp"
+#include "CSpreadsheet.hpp"
+
+void CProgram::emit(COp op)
+{
+    m_code.push_back({op});
+}
+
+void CProgram::emitConstant(const CContent &value)
+{
+    m_code.push_back({COp::CONSTANT, static_cast<uint32_t>(m_constants.size())});
+    m_constants.push_back(value);
+}
+
+void CProgram::emitReference(const CCellKey &pos, bool isAbsRow, bool isAbsCol)
+{
+    m_code.push_back({COp::REFERENCE, static_cast<uint32_t>(m_references.size())});
+    m_references.push_back({pos, isAbsRow, isAbsCol});
+    addReach(pos, isAbsRow, isAbsCol);
+}
+
+void CProgram::addRange(const CCellKey &first, bool isAbsFirstRow, bool isAbsFirstCol,
+                        const CCellKey &last, bool isAbsLastRow, bool isAbsLastCol)
+{
+    m_ranges.push_back({{first, isAbsFirstRow, isAbsFirstCol}, {last, isAbsLastRow, isAbsLastCol}});
+    addReach(first, isAbsFirstRow, isAbsFirstCol);
+    addReach(last, isAbsLastRow, isAbsLastCol);
+}
+
+void CProgram::emitAggregate(CAggregateKind kind, uint32_t valueCount)
+{
+    m_code.push_back({COp::AGGREGATE, static_cast<uint32_t>(m_aggregates.size())});
+    m_aggregates.push_back({kind, valueCount, m_usedRanges, static_cast<uint32_t>(m_ranges.size())});
+    m_usedRanges = static_cast<uint32_t>(m_ranges.size());
+}
+
+void CProgram::emitLookup(CLookupKind kind, uint32_t valueCount)
+{
+    m_code.push_back({COp::LOOKUP, static_cast<uint32_t>(m_lookups.size())});
+    m_lookups.push_back({kind, valueCount, static_cast<uint32_t>(m_ranges.size() - 1)});
+    m_usedRanges = static_cast<uint32_t>(m_ranges.size());
+}
+
+size_t CProgram::emitJump(COp op)
+{
+    m_code.push_back({op});
+    return m_code.size() - 1;
+}
+
+void CProgram::patchJump(size_t jump)
+{
+    m_code[jump].m_arg = static_cast<uint32_t>(m_code.size());
+}
+
+size_t CProgram::emitSelect(uint32_t caseCount)
+{
+    m_code.push_back({COp::SELECT, static_cast<uint32_t>(m_selects.size())});
+    m_selects.push_back({static_cast<uint32_t>(m_targets.size()), caseCount});
+    m_targets.resize(m_targets.size() + caseCount + 1);
+    return m_selects.size() - 1;
+}
+
+void CProgram::patchSelect(size_t select, uint32_t caseIndex)
+{
+    m_targets[m_selects[select].m_firstTarget + caseIndex] = static_cast<uint32_t>(m_code.size());
+}
+
+void CProgram::addReach(const CCellKey &pos, bool isAbsRow, bool isAbsCol)
+{
+    if (!isAbsRow)
+    {
+        m_firstRow = std::min(m_firstRow, static_cast<int64_t>(pos.getRow()));
+        m_lastRow = std::max(m_lastRow, static_cast<int64_t>(pos.getRow()));
+    }
+    if (!isAbsCol)
+    {
+        m_firstCol = std::min(m_firstCol, static_cast<int64_t>(pos.getCol()));
+        m_lastCol = std::max(m_lastCol, static_cast<int64_t>(pos.getCol()));
+    }
+}
+
+bool CProgram::fitsAt(const CCellShift &origin) const
+{
+    constexpr int64_t maxIndex = static_cast<int64_t>(CCellKey::MAX_INDEX);
+    bool rowsFit = m_firstRow > m_lastRow || (m_firstRow + origin.m_rows >= 0 && m_lastRow + origin.m_rows <= maxIndex);
+    bool colsFit = m_firstCol > m_lastCol || (m_firstCol + origin.m_cols >= 0 && m_lastCol + origin.m_cols <= maxIndex);
+    return rowsFit && colsFit;
+}
+
+std::optional<CCellRange> CProgram::rangeAt(uint32_t range, const CCellShift &origin) const
+{
+    const auto &[first, last] = m_ranges[range];
+    std::optional<CCellKey> firstPos = first.m_key.resolvedAt(origin, first.m_isAbsRow, first.m_isAbsCol);
+    std::optional<CCellKey> lastPos = last.m_key.resolvedAt(origin, last.m_isAbsRow, last.m_isAbsCol);
+    if (!firstPos || !lastPos)
+    {
+        return std::nullopt;
+    }
+    return CCellRange(*firstPos, *lastPos);
+}
+
+CContent CProgram::run(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    // plain values dont need the stack at all
+    if (m_code.size() == 1 && m_code.front().m_op == COp::CONSTANT)
+    {
+        return m_constants.front();
+    }
+
+    // one stack per thread shared by all programs, a program evaluated because of REFERENCE
+    // works above the values of the one that called it and leaves the stack as it found it
+    thread_local std::vector<CContent> stack;
+    size_t base = stack.size();
+    for (size_t next = 0; next < m_code.size();)
+    {
+        const CInstruction &instruction = m_code[next++];
+        switch (instruction.m_op)
+        {
+        case COp::CONSTANT:
+            stack.push_back(m_constants[instruction.m_arg]);
+            continue;
+        case COp::REFERENCE:
+        {
+            const CReferenceArg &reference = m_references[instruction.m_arg];
+            std::optional<CCellKey> pos = reference.m_key.resolvedAt(origin, reference.m_isAbsRow, reference.m_isAbsCol);
+            stack.push_back(pos ? sheet.evalCell(*pos) : CContent());
+            continue;
+        }
+        case COp::AGGREGATE:
+        {
+            const CAggregateArg &aggregate = m_aggregates[instruction.m_arg];
+            CAggregator aggregator(aggregate.m_kind);
+            for (size_t i = stack.size() - aggregate.m_valueCount; i < stack.size(); i++)
+            {
+                aggregator.add(stack[i]);
+            }
+            stack.resize(stack.size() - aggregate.m_valueCount);
+            for (uint32_t i = aggregate.m_firstRange; i < aggregate.m_lastRange; i++)
+            {
+                if (std::optional<CCellRange> range = rangeAt(i, origin))
+                {
+                    sheet.aggregate(*range, aggregator);
+                }
+            }
+            stack.push_back(aggregator.result());
+            continue;
+        }
+        case COp::LOOKUP:
+        {
+            const CLookupArg &lookup = m_lookups[instruction.m_arg];
+            std::optional<CCellRange> range = rangeAt(lookup.m_range, origin);
+            // the values are moved off the stack first, cells evaluated by the lookup may grow it
+            std::array<CContent, 3> values;
+            size_t valuesStart = stack.size() - lookup.m_valueCount;
+            std::move(stack.begin() + valuesStart, stack.end(), values.begin());
+            stack.resize(valuesStart);
+            stack.push_back(range ? sheet.lookup(lookup.m_kind, *range, std::span<const CContent>(values.data(), lookup.m_valueCount))
+                                  : CContent());
+            continue;
+        }
+        case COp::JUMP:
+            next = instruction.m_arg;
+            continue;
+        case COp::JUMP_IF_FALSE:
+        case COp::JUMP_IF_TRUE:
+        {
+            bool isTrue = stack.back().getDouble() != 0;
+            stack.pop_back();
+            if (isTrue == (instruction.m_op == COp::JUMP_IF_TRUE))
+            {
+                next = instruction.m_arg;
+            }
+            continue;
+        }
+        case COp::JUMP_IF_NOT_NUMBER:
+            if (!stack.back().isDouble())
+            {
+                stack.back() = CContent();
+                next = instruction.m_arg;
+            }
+            continue;
+        case COp::JUMP_IF_VALUE:
+            if (!stack.back().isMonostate())
+            {
+                next = instruction.m_arg;
+            }
+            else
+            {
+                stack.pop_back();
+            }
+            continue;
+        case COp::SELECT:
+        {
+            const CSelectArg &select = m_selects[instruction.m_arg];
+            CContent value = std::move(stack.back());
+            stack.pop_back();
+            double n = value.isDouble() ? std::trunc(value.getDouble()) : 0;
+            if (n >= 1 && n <= select.m_caseCount)
+            {
+                next = m_targets[select.m_firstTarget + static_cast<uint32_t>(n) - 1];
+            }
+            else
+            {
+                stack.push_back(CContent());
+                next = m_targets[select.m_firstTarget + select.m_caseCount];
+            }
+            continue;
+        }
+        case COp::NEG:
+            stack.back() = -stack.back();
+            continue;
+        default:
+            break;
+        }
+
+        CContent rhs = std::move(stack.back());
+        stack.pop_back();
+        CContent &lhs = stack.back();
+        switch (instruction.m_op)
+        {
+        case COp::ADD:
+            lhs = std::move(lhs) + rhs; // a string result of an earlier instruction is extended in place
+            break;
+        case COp::SUB:
+            lhs = lhs - rhs;
+            break;
+        case COp::MUL:
+            lhs = lhs * rhs;
+            break;
+        case COp::DIV:
+            lhs = lhs / rhs;
+            break;
+        case COp::POW:
+            lhs = lhs.toExp(rhs);
+            break;
+        case COp::EQ:
+            lhs = lhs == rhs;
+            break;
+        case COp::NE:
+            lhs = lhs != rhs;
+            break;
+        case COp::LT:
+            lhs = lhs < rhs;
+            break;
+        case COp::LE:
+            lhs = lhs <= rhs;
+            break;
+        case COp::GT:
+            lhs = lhs > rhs;
+            break;
+        case COp::GE:
+            lhs = lhs >= rhs;
+            break;
+        default:
+            break;
+        }
+    }
+    CContent result = std::move(stack.back());
+    stack.resize(base);
+    return result;
+}
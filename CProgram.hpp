@@ -0,0 +1,136 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <optional>
+
+#include "CAggregator.hpp"
+#include "CCellKey.hpp"
+#include "CContent.hpp"
+#include "CLookupIndex.hpp"
+
+class CSpreadsheet;
+
+// operations of the stack machine, operands are popped from the stack and the result is pushed back
+enum class COp : uint8_t
+{
+    CONSTANT,  // pushes constant with index arg
+    REFERENCE, // pushes value of the cell read by reference with index arg
+    AGGREGATE, // replaces the values of the aggregate with index arg by its result, reading its ranges as well
+    LOOKUP,    // replaces the values of the lookup with index arg by its result, reading its range as well
+    // jumps to instruction arg, the ones below only under a condition. They let lazy functions skip branches
+    JUMP,
+    JUMP_IF_FALSE,      // pops a number, jumps if it is 0
+    JUMP_IF_TRUE,       // pops a number, jumps if it isnt 0
+    JUMP_IF_NOT_NUMBER, // if the top isnt a number, replaces it by empty value and jumps
+    JUMP_IF_VALUE,      // if the top isnt empty, jumps and keeps it, otherwise pops it
+    SELECT,             // pops n, jumps to case n of the select with index arg (see emitSelect)
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    POW,
+    NEG,
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE
+};
+
+struct CInstruction
+{
+    COp m_op;
+    uint32_t m_arg = 0;
+};
+
+// expression tree compiled to a flat list of instructions (postfix order), evaluated by a single loop
+// like the tree, a program can be shared by cells, references are resolved against the origin it is run with
+class CProgram
+{
+public:
+    // appends instructions, called by CExpr::compile
+    void emit(COp op);
+    void emitConstant(const CContent &value);
+    void emitReference(const CCellKey &pos, bool isAbsRow, bool isAbsCol);
+
+    // adds a range read by the next emitted aggregate or lookup, its corners are resolved like references
+    void addRange(const CCellKey &first, bool isAbsFirstRow, bool isAbsFirstCol,
+                  const CCellKey &last, bool isAbsLastRow, bool isAbsLastCol);
+
+    // aggregates valueCount values on top of the stack together with the ranges added since the last aggregate
+    void emitAggregate(CAggregateKind kind, uint32_t valueCount);
+
+    // looks up in the range added last, valueCount values on top of the stack are the other arguments in order
+    void emitLookup(CLookupKind kind, uint32_t valueCount);
+
+    // appends a jump of op with its target left for patchJump, returns its position
+    size_t emitJump(COp op);
+
+    // sets the target of the jump at position jump to the next emitted instruction
+    void patchJump(size_t jump);
+
+    // appends a jump to one of caseCount cases, taken for a number n in [1, caseCount] truncated toward zero.
+    // Other values jump to the end of the select with empty value pushed. Returns the index of the select
+    size_t emitSelect(uint32_t caseCount);
+
+    // sets the target of the case (or of the end, if it is caseCount) of select to the next emitted instruction
+    void patchSelect(size_t select, uint32_t caseIndex);
+
+    // notes a position read by the program without emitting anything, references and ranges note their own
+    void addReach(const CCellKey &pos, bool isAbsRow, bool isAbsCol);
+
+    // true if all positions read by the program stay in the sheet when it is run with origin
+    bool fitsAt(const CCellShift &origin) const;
+
+    CContent run(const CSpreadsheet &sheet, const CCellShift &origin) const;
+
+private:
+    struct CReferenceArg
+    {
+        CCellKey m_key;
+        bool m_isAbsRow;
+        bool m_isAbsCol;
+    };
+
+    struct CAggregateArg
+    {
+        CAggregateKind m_kind;
+        uint32_t m_valueCount;
+        uint32_t m_firstRange; // ranges are m_ranges[m_firstRange, m_lastRange)
+        uint32_t m_lastRange;
+    };
+
+    struct CLookupArg
+    {
+        CLookupKind m_kind;
+        uint32_t m_valueCount;
+        uint32_t m_range;
+    };
+
+    struct CSelectArg
+    {
+        uint32_t m_firstTarget; // targets of the cases and of the end are m_targets[m_firstTarget, + caseCount]
+        uint32_t m_caseCount;
+    };
+
+    // cells of m_ranges[range] read with origin, nullopt if a corner is outside of the sheet
+    std::optional<CCellRange> rangeAt(uint32_t range, const CCellShift &origin) const;
+
+    std::vector<CInstruction> m_code;
+    std::vector<CContent> m_constants;
+    std::vector<CReferenceArg> m_references;
+    std::vector<std::pair<CReferenceArg, CReferenceArg>> m_ranges; // corners
+    std::vector<CAggregateArg> m_aggregates;
+    std::vector<CLookupArg> m_lookups;
+    uint32_t m_usedRanges = 0; // ranges before it are read by instructions emitted already
+    std::vector<CSelectArg> m_selects;
+    std::vector<uint32_t> m_targets;
+    // relative rows and cols read by the program are in [m_firstRow, m_lastRow] and [m_firstCol, m_lastCol]
+    int64_t m_firstRow = INT64_MAX;
+    int64_t m_lastRow = -1;
+    int64_t m_firstCol = INT64_MAX;
+    int64_t m_lastCol = -1;
+};
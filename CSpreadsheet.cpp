@@ -1,877 +1,2522 @@
 #include "CSpreadsheet.hpp"
 
+// CDependencies
+
+void CDependencies::addCell(const CCellKey &pos)
+{
+    if (!m_isConditional)
+    {
+        m_cells.insert(pos);
+        m_conditionalCells.erase(pos);
+    }
+    else if (m_cells.insert(pos).second)
+    {
+        m_conditionalCells.insert(pos);
+    }
+}
+
+void CDependencies::addRange(const CCellRange &range)
+{
+    bool isKnown = std::find(m_ranges.begin(), m_ranges.end(), range) != m_ranges.end();
+    if (!m_isConditional)
+    {
+        std::erase(m_conditionalRanges, range);
+    }
+    else if (!isKnown)
+    {
+        m_conditionalRanges.push_back(range);
+    }
+    if (!isKnown)
+    {
+        m_ranges.push_back(range);
+    }
+}
+
 // Reference
 
-Reference::Reference(const std::string &pos) : m_pos(pos) {}
+Reference::Reference(const std::string &pos)
+{
+    if (pos == CParser::OFF_SHEET)
+    {
+        m_isOffSheet = true;
+        return;
+    }
+    CPos parsed(pos);
+    m_key = CCellKey(parsed);
+    m_isAbsRow = parsed.m_isAbsRow;
+    m_isAbsCol = parsed.m_isAbsCol;
+}
+
+CExprPtr Reference::clone(CNodeArena *arena) const
+{
+    return makeNode<Reference>(arena, *this);
+}
+
+CContent Reference::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    std::optional<CCellKey> pos = m_isOffSheet ? std::nullopt : m_key.resolvedAt(origin, m_isAbsRow, m_isAbsCol);
+    return pos ? sheet.evalCell(*pos) : CContent();
+}
+
+void Reference::compile(CProgram &program) const
+{
+    if (m_isOffSheet)
+    {
+        program.emitConstant(CContent());
+        return;
+    }
+    program.emitReference(m_key, m_isAbsRow, m_isAbsCol);
+}
+
+bool Reference::isConstant() const
+{
+    return false;
+}
+
+void Reference::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    std::optional<CCellKey> pos = m_isOffSheet ? std::nullopt : m_key.resolvedAt(origin, m_isAbsRow, m_isAbsCol);
+    if (pos)
+    {
+        dependencies.addCell(*pos);
+    }
+}
+
+void Reference::updateRef(const CCellShift &shift)
+{
+    std::optional<CCellKey> pos = m_isOffSheet ? std::nullopt : m_key.resolvedAt(shift, m_isAbsRow, m_isAbsCol);
+    m_isOffSheet = !pos;
+    m_key = pos.value_or(CCellKey());
+}
+
+void Reference::print(std::ostream &os, const CCellShift &origin) const
+{
+    std::optional<CCellKey> pos = m_isOffSheet ? std::nullopt : m_key.resolvedAt(origin, m_isAbsRow, m_isAbsCol);
+    if (!pos)
+    {
+        os << CParser::OFF_SHEET;
+        return;
+    }
+    os << pos->toPos(m_isAbsRow, m_isAbsCol);
+}
+
+// Range
+
+Range::Range(const std::string &range)
+{
+    size_t colon = range.find(':');
+    if (colon == std::string::npos)
+    {
+        throw std::invalid_argument("missing : in range");
+    }
+    std::string_view firstText = std::string_view(range).substr(0, colon);
+    std::string_view lastText = std::string_view(range).substr(colon + 1);
+    if (firstText == CParser::OFF_SHEET || lastText == CParser::OFF_SHEET)
+    {
+        m_isOffSheet = true;
+        return;
+    }
+    CPos first(firstText);
+    CPos last(lastText);
+    m_first = CCellKey(first);
+    m_last = CCellKey(last);
+    m_isAbsFirstRow = first.m_isAbsRow;
+    m_isAbsFirstCol = first.m_isAbsCol;
+    m_isAbsLastRow = last.m_isAbsRow;
+    m_isAbsLastCol = last.m_isAbsCol;
+}
+
+CExprPtr Range::clone(CNodeArena *arena) const
+{
+    return makeNode<Range>(arena, *this);
+}
+
+CContent Range::eval(const CSpreadsheet &sheet, const CCellShift &) const
+{
+    sheet.capabilities(); // does nothing, however compiler doesnt complain about unused param
+    return CContent();
+}
+
+void Range::compile(CProgram &program) const
+{
+    if (!m_isOffSheet)
+    {
+        program.addReach(m_first, m_isAbsFirstRow, m_isAbsFirstCol);
+        program.addReach(m_last, m_isAbsLastRow, m_isAbsLastCol);
+    }
+    program.emitConstant(CContent());
+}
+
+bool Range::isConstant() const
+{
+    return false;
+}
+
+void Range::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    if (std::optional<CCellRange> range = at(origin))
+    {
+        dependencies.addRange(*range);
+    }
+}
 
-std::shared_ptr<CExpr> Reference::clone() const
+void Range::updateRef(const CCellShift &shift)
 {
-    return std::make_shared<Reference>(*this);
+    std::optional<CCellRange> range = at(shift);
+    if (!range)
+    {
+        m_isOffSheet = true;
+        return;
+    }
+    // the corners are kept as written, so a range written bottom up is printed the same way
+    m_first = *m_first.resolvedAt(shift, m_isAbsFirstRow, m_isAbsFirstCol);
+    m_last = *m_last.resolvedAt(shift, m_isAbsLastRow, m_isAbsLastCol);
 }
 
-CContent Reference::eval(const CSpreadsheet &sheet) const
+void Range::print(std::ostream &os, const CCellShift &origin) const
 {
-    return sheet.getCell(m_pos)->eval(sheet);
+    if (!at(origin))
+    {
+        os << CParser::OFF_SHEET << ":" << CParser::OFF_SHEET;
+        return;
+    }
+    os << m_first.resolvedAt(origin, m_isAbsFirstRow, m_isAbsFirstCol)->toPos(m_isAbsFirstRow, m_isAbsFirstCol) << ":"
+       << m_last.resolvedAt(origin, m_isAbsLastRow, m_isAbsLastCol)->toPos(m_isAbsLastRow, m_isAbsLastCol);
 }
 
-void Reference::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+std::optional<CCellRange> Range::at(const CCellShift &origin) const
 {
-    dependencies.insert(m_pos);
+    if (m_isOffSheet)
+    {
+        return std::nullopt;
+    }
+    std::optional<CCellKey> first = m_first.resolvedAt(origin, m_isAbsFirstRow, m_isAbsFirstCol);
+    std::optional<CCellKey> last = m_last.resolvedAt(origin, m_isAbsLastRow, m_isAbsLastCol);
+    if (!first || !last)
+    {
+        return std::nullopt;
+    }
+    return CCellRange(*first, *last);
 }
 
-void Reference::updateRef(int i, int j)
+bool Range::isOffSheet() const
 {
-    m_pos.shiftBy(i, j);
+    return m_isOffSheet;
 }
 
-void Reference::print(std::ostream &os) const
+void Range::compileRange(CProgram &program) const
 {
-    os << m_pos;
+    program.addRange(m_first, m_isAbsFirstRow, m_isAbsFirstCol, m_last, m_isAbsLastRow, m_isAbsLastCol);
 }
 
 // Literal
 
 Literal::Literal(CContent val) : m_value(val) {}
 
-std::shared_ptr<CExpr> Literal::clone() const
+CExprPtr Literal::clone(CNodeArena *arena) const
 {
-    return std::make_shared<Literal>(*this);
+    return makeNode<Literal>(arena, *this);
 }
 
-CContent Literal::eval(const CSpreadsheet &sheet) const
+CContent Literal::eval(const CSpreadsheet &sheet, const CCellShift &) const
 {
     sheet.capabilities(); // does nothing, however compiler doesnt complain about unused param
     return m_value;
 }
 
-void Literal::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Literal::compile(CProgram &program) const
 {
-    dependencies.begin(); // does nothing, however compiler doesnt complain about unused param
-    return;
+    program.emitConstant(m_value);
+}
+
+bool Literal::isConstant() const
+{
+    return true;
 }
 
-void Literal::updateRef(int i, int j)
+void Literal::getDependencies(CDependencies &dependencies, const CCellShift &) const
 {
-    CPos("A0").shiftBy(i, j); // does nothing, however compiler doesnt complain about unused param
+    dependencies.m_cells.begin(); // does nothing, however compiler doesnt complain about unused param
     return;
 }
 
-void Literal::print(std::ostream &os) const
+void Literal::updateRef(const CCellShift &)
+{
+}
+
+const CContent &Literal::getValue() const
+{
+    return m_value;
+}
+
+void Literal::print(std::ostream &os, const CCellShift &) const
 {
+    // negative numbers are printed like a negation, so they can stand anywhere an operand can
+    if (m_value.isDouble() && std::signbit(m_value.getDouble()))
+    {
+        os << "(" << m_value << ")";
+        return;
+    }
     os << m_value;
 }
 
 // Addition
 
-Addition::Addition(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Addition::Addition(CExprPtr lhs, CExprPtr rhs)
     : CExpr(), m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Addition::clone() const
+CExprPtr Addition::clone(CNodeArena *arena) const
 {
-    return std::make_shared<Addition>(Addition(m_Lhs->clone(), m_Rhs->clone()));
+    return makeNode<Addition>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
 }
 
-void Addition::print(std::ostream &os) const
+void Addition::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "+";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
-CContent Addition::eval(const CSpreadsheet &sheet) const
+CContent Addition::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) + m_Rhs->eval(sheet, origin);
+}
+
+void Addition::compile(CProgram &program) const
+{
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::ADD);
+}
+
+bool Addition::isConstant() const
 {
-    return m_Lhs->eval(sheet) + m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void Addition::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Addition::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Addition::updateRef(int i, int j)
+void Addition::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
 // Multiplication
 
-Multiplication::Multiplication(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Multiplication::Multiplication(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Multiplication::clone() const
+CExprPtr Multiplication::clone(CNodeArena *arena) const
+{
+    return makeNode<Multiplication>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent Multiplication::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) * m_Rhs->eval(sheet, origin);
+}
+
+void Multiplication::compile(CProgram &program) const
 {
-    return std::make_shared<Multiplication>(Multiplication(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::MUL);
 }
 
-CContent Multiplication::eval(const CSpreadsheet &sheet) const
+bool Multiplication::isConstant() const
 {
-    return m_Lhs->eval(sheet) * m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void Multiplication::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Multiplication::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Multiplication::updateRef(int i, int j)
+void Multiplication::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void Multiplication::print(std::ostream &os) const
+void Multiplication::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "*";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // Division
 
-Division::Division(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Division::Division(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Division::clone() const
+CExprPtr Division::clone(CNodeArena *arena) const
 {
-    return std::make_shared<Division>(Division(m_Lhs->clone(), m_Rhs->clone()));
+    return makeNode<Division>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
 }
 
-CContent Division::eval(const CSpreadsheet &sheet) const
+CContent Division::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
 {
-    return m_Lhs->eval(sheet) / m_Rhs->eval(sheet);
+    return m_Lhs->eval(sheet, origin) / m_Rhs->eval(sheet, origin);
 }
 
-void Division::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Division::compile(CProgram &program) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::DIV);
 }
 
-void Division::updateRef(int i, int j)
+bool Division::isConstant() const
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void Division::print(std::ostream &os) const
+void Division::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
+}
+
+void Division::updateRef(const CCellShift &shift)
+{
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
+}
+
+void Division::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "/";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // Subtraction
 
-Subtraction::Subtraction(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Subtraction::Subtraction(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Subtraction::clone() const
+CExprPtr Subtraction::clone(CNodeArena *arena) const
+{
+    return makeNode<Subtraction>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent Subtraction::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) - m_Rhs->eval(sheet, origin);
+}
+
+void Subtraction::compile(CProgram &program) const
 {
-    return std::make_shared<Subtraction>(Subtraction(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::SUB);
 }
 
-CContent Subtraction::eval(const CSpreadsheet &sheet) const
+bool Subtraction::isConstant() const
 {
-    return m_Lhs->eval(sheet) - m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
-void Subtraction::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+
+void Subtraction::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Subtraction::updateRef(int i, int j)
+void Subtraction::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void Subtraction::print(std::ostream &os) const
+void Subtraction::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "-";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // Exponentiation
 
-Exponentiation::Exponentiation(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Exponentiation::Exponentiation(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Exponentiation::clone() const
+CExprPtr Exponentiation::clone(CNodeArena *arena) const
+{
+    return makeNode<Exponentiation>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent Exponentiation::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
 {
-    return std::make_shared<Exponentiation>(Exponentiation(m_Lhs->clone(), m_Rhs->clone()));
+    return m_Lhs->eval(sheet, origin).toExp(m_Rhs->eval(sheet, origin));
 }
 
-CContent Exponentiation::eval(const CSpreadsheet &sheet) const
+void Exponentiation::compile(CProgram &program) const
 {
-    return m_Lhs->eval(sheet).toExp(m_Rhs->eval(sheet));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::POW);
 }
-void Exponentiation::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+
+bool Exponentiation::isConstant() const
+{
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
+}
+
+void Exponentiation::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Exponentiation::updateRef(int i, int j)
+void Exponentiation::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void Exponentiation::print(std::ostream &os) const
+void Exponentiation::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "^";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // Negation
 
-Negation::Negation(std::shared_ptr<CExpr> rhs) : m_Rhs(std::move(rhs)) {}
+Negation::Negation(CExprPtr rhs) : m_Rhs(std::move(rhs)) {}
+
+CExprPtr Negation::clone(CNodeArena *arena) const
+{
+    return makeNode<Negation>(arena, m_Rhs->clone(arena));
+}
+
+CContent Negation::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return -(m_Rhs->eval(sheet, origin));
+}
 
-std::shared_ptr<CExpr> Negation::clone() const
+void Negation::compile(CProgram &program) const
 {
-    return std::make_shared<Negation>(Negation(m_Rhs->clone()));
+    m_Rhs->compile(program);
+    program.emit(COp::NEG);
 }
 
-CContent Negation::eval(const CSpreadsheet &sheet) const
+bool Negation::isConstant() const
 {
-    return -(m_Rhs->eval(sheet));
+    return m_Rhs->isConstant();
 }
 
-void Negation::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Negation::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Rhs->getDependencies(dependencies);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Negation::updateRef(int i, int j)
+void Negation::updateRef(const CCellShift &shift)
 {
-    m_Rhs->updateRef(i, j);
+    m_Rhs->updateRef(shift);
 }
 
-void Negation::print(std::ostream &os) const
+void Negation::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
     os << "-";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // LessThan
 
-LessThan::LessThan(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+LessThan::LessThan(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> LessThan::clone() const
+CExprPtr LessThan::clone(CNodeArena *arena) const
+{
+    return makeNode<LessThan>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent LessThan::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) < m_Rhs->eval(sheet, origin);
+}
+
+void LessThan::compile(CProgram &program) const
 {
-    return std::make_shared<LessThan>(LessThan(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::LT);
 }
 
-CContent LessThan::eval(const CSpreadsheet &sheet) const
+bool LessThan::isConstant() const
 {
-    return m_Lhs->eval(sheet) < m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void LessThan::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void LessThan::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void LessThan::updateRef(int i, int j)
+void LessThan::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void LessThan::print(std::ostream &os) const
+void LessThan::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "<";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // GreaterThan
 
-GreaterThan::GreaterThan(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+GreaterThan::GreaterThan(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> GreaterThan::clone() const
+CExprPtr GreaterThan::clone(CNodeArena *arena) const
 {
-    return std::make_shared<GreaterThan>(GreaterThan(m_Lhs->clone(), m_Rhs->clone()));
+    return makeNode<GreaterThan>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
 }
 
-CContent GreaterThan::eval(const CSpreadsheet &sheet) const
+CContent GreaterThan::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
 {
-    return m_Lhs->eval(sheet) > m_Rhs->eval(sheet);
+    return m_Lhs->eval(sheet, origin) > m_Rhs->eval(sheet, origin);
 }
 
-void GreaterThan::updateRef(int i, int j)
+void GreaterThan::compile(CProgram &program) const
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::GT);
 }
 
-void GreaterThan::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+bool GreaterThan::isConstant() const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void GreaterThan::print(std::ostream &os) const
+void GreaterThan::updateRef(const CCellShift &shift)
+{
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
+}
+
+void GreaterThan::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
+}
+
+void GreaterThan::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << ">";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // Equal
 
-Equal::Equal(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+Equal::Equal(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> Equal::clone() const
+CExprPtr Equal::clone(CNodeArena *arena) const
+{
+    return makeNode<Equal>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent Equal::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) == m_Rhs->eval(sheet, origin);
+}
+
+void Equal::compile(CProgram &program) const
 {
-    return std::make_shared<Equal>(Equal(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::EQ);
 }
 
-CContent Equal::eval(const CSpreadsheet &sheet) const
+bool Equal::isConstant() const
 {
-    return m_Lhs->eval(sheet) == m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void Equal::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void Equal::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void Equal::updateRef(int i, int j)
+void Equal::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void Equal::print(std::ostream &os) const
+void Equal::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "=";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // NotEqual
 
-NotEqual::NotEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+NotEqual::NotEqual(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> NotEqual::clone() const
+CExprPtr NotEqual::clone(CNodeArena *arena) const
+{
+    return makeNode<NotEqual>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent NotEqual::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) != m_Rhs->eval(sheet, origin);
+}
+
+void NotEqual::compile(CProgram &program) const
 {
-    return std::make_shared<NotEqual>(NotEqual(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::NE);
 }
 
-CContent NotEqual::eval(const CSpreadsheet &sheet) const
+bool NotEqual::isConstant() const
 {
-    return m_Lhs->eval(sheet) != m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void NotEqual::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void NotEqual::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void NotEqual::updateRef(int i, int j)
+void NotEqual::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void NotEqual::print(std::ostream &os) const
+void NotEqual::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "<>";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // LessEqual
 
-LessEqual::LessEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+LessEqual::LessEqual(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> LessEqual::clone() const
+CExprPtr LessEqual::clone(CNodeArena *arena) const
+{
+    return makeNode<LessEqual>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
+}
+
+CContent LessEqual::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    return m_Lhs->eval(sheet, origin) <= m_Rhs->eval(sheet, origin);
+}
+
+void LessEqual::compile(CProgram &program) const
 {
-    return std::make_shared<LessEqual>(LessEqual(m_Lhs->clone(), m_Rhs->clone()));
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::LE);
 }
 
-CContent LessEqual::eval(const CSpreadsheet &sheet) const
+bool LessEqual::isConstant() const
 {
-    return m_Lhs->eval(sheet) <= m_Rhs->eval(sheet);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void LessEqual::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void LessEqual::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
 }
 
-void LessEqual::updateRef(int i, int j)
+void LessEqual::updateRef(const CCellShift &shift)
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
 }
 
-void LessEqual::print(std::ostream &os) const
+void LessEqual::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << "<=";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
 // GreaterEqual
 
-GreaterEqual::GreaterEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs)
+GreaterEqual::GreaterEqual(CExprPtr lhs, CExprPtr rhs)
     : m_Lhs(std::move(lhs)), m_Rhs(std::move(rhs)) {}
 
-std::shared_ptr<CExpr> GreaterEqual::clone() const
+CExprPtr GreaterEqual::clone(CNodeArena *arena) const
 {
-    return std::make_shared<GreaterEqual>(GreaterEqual(m_Lhs->clone(), m_Rhs->clone()));
+    return makeNode<GreaterEqual>(arena, m_Lhs->clone(arena), m_Rhs->clone(arena));
 }
 
-CContent GreaterEqual::eval(const CSpreadsheet &sheet) const
+CContent GreaterEqual::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
 {
-    return m_Lhs->eval(sheet) >= m_Rhs->eval(sheet);
+    return m_Lhs->eval(sheet, origin) >= m_Rhs->eval(sheet, origin);
 }
 
-void GreaterEqual::getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const
+void GreaterEqual::compile(CProgram &program) const
 {
-    m_Lhs->getDependencies(dependencies);
-    m_Rhs->getDependencies(dependencies);
+    m_Lhs->compile(program);
+    m_Rhs->compile(program);
+    program.emit(COp::GE);
 }
 
-void GreaterEqual::updateRef(int i, int j)
+bool GreaterEqual::isConstant() const
 {
-    m_Lhs->updateRef(i, j);
-    m_Rhs->updateRef(i, j);
+    return m_Lhs->isConstant() && m_Rhs->isConstant();
 }
 
-void GreaterEqual::print(std::ostream &os) const
+void GreaterEqual::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    m_Lhs->getDependencies(dependencies, origin);
+    m_Rhs->getDependencies(dependencies, origin);
+}
+
+void GreaterEqual::updateRef(const CCellShift &shift)
+{
+    m_Lhs->updateRef(shift);
+    m_Rhs->updateRef(shift);
+}
+
+void GreaterEqual::print(std::ostream &os, const CCellShift &origin) const
 {
     os << "(";
-    m_Lhs->print(os);
+    m_Lhs->print(os, origin);
     os << ">=";
-    m_Rhs->print(os);
+    m_Rhs->print(os, origin);
     os << ")";
 }
 
-// CSpreadsheet
+// Aggregate
 
-CSpreadsheet::CSpreadsheet() {}
+Aggregate::Aggregate(CAggregateKind kind, std::vector<CExprPtr> args)
+    : m_kind(kind), m_args(std::move(args)) {}
 
-bool CSpreadsheet::load(std::istream &is)
+CExprPtr Aggregate::clone(CNodeArena *arena) const
 {
-    if (!is.good())
-        return false;
-
-    m_table.clear();
-    size_t cellCount = 0;
-    if (!(is >> cellCount))
-        return false;
-
-    if (is.get() != separator)
-        return false;
-
-    for (size_t i = 0; i < cellCount; i++)
+    std::vector<CExprPtr> args;
+    args.reserve(m_args.size());
+    for (const CExprPtr &arg : m_args)
     {
-        std::string posInput;
-        if (!loadString(is, posInput))
-            return false;
+        args.push_back(arg->clone(arena));
+    }
+    return makeNode<Aggregate>(arena, m_kind, std::move(args));
+}
 
-        try
+CContent Aggregate::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    CAggregator aggregator(m_kind);
+    for (const CExprPtr &arg : m_args)
+    {
+        if (const Range *range = dynamic_cast<const Range *>(arg.get()))
         {
-            CPos x(posInput);
+            if (std::optional<CCellRange> cells = range->at(origin))
+            {
+                sheet.aggregate(*cells, aggregator);
+            }
         }
-        catch (std::invalid_argument &e)
+        else
         {
-            return false;
+            aggregator.add(arg->eval(sheet, origin));
         }
-
-        std::string exprInput;
-        if (!loadString(is, exprInput))
-            return false;
-
-        if (!setCell(CPos(posInput), exprInput))
-            return false;
     }
-    if (is.get() != EOF)
-        return false;
-
-    return true;
+    return aggregator.result();
 }
 
-bool CSpreadsheet::loadChars(size_t count, std::string &buffer, std::istream &is) const
+void Aggregate::compile(CProgram &program) const
 {
-    char ch;
-    for (size_t i = 0; i < count; i++)
+    // values first, aggregates nested in them take their ranges with them before this one adds its own
+    uint32_t valueCount = 0;
+    for (const CExprPtr &arg : m_args)
     {
-        if (!is.get(ch))
+        if (!dynamic_cast<const Range *>(arg.get()))
         {
-            return false;
+            arg->compile(program);
+            valueCount++;
         }
-        else
+    }
+    for (const CExprPtr &arg : m_args)
+    {
+        const Range *range = dynamic_cast<const Range *>(arg.get());
+        if (range && !range->isOffSheet())
         {
-            buffer += ch;
+            range->compileRange(program);
         }
     }
-    return true;
+    program.emitAggregate(m_kind, valueCount);
 }
 
-bool CSpreadsheet::loadString(std::istream &is, std::string &out) const
+bool Aggregate::isConstant() const
 {
-    size_t size = 0;
-    if (!(is >> size))
-        return false;
-    if (is.get() != separator)
-        return false;
-    if (!loadChars(size, out, is))
-        return false;
-    if (is.get() != separator)
-        return false;
-    return true;
+    return std::all_of(m_args.begin(), m_args.end(), [](const CExprPtr &arg)
+                       { return arg->isConstant(); });
 }
 
-bool CSpreadsheet::save(std::ostream &os) const
+void Aggregate::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
 {
-    //[cellCount]|[posSize]|[pos]|[exprSize]=[expr]|...|
-
-    if (!(os << m_table.size()))
-        return false;
-    if (!(os << separator))
-        return false;
-    for (auto it = m_table.begin(); it != m_table.end(); it++)
+    for (const CExprPtr &arg : m_args)
     {
-        if (!savePos(os, it->first))
-            return false;
-        if (!saveExpr(os, *(it->second.get())))
-            return false;
+        arg->getDependencies(dependencies, origin);
     }
-    return os.good();
 }
 
-bool CSpreadsheet::savePos(std::ostream &os, const CPos &pos) const
+void Aggregate::updateRef(const CCellShift &shift)
 {
-    std::ostringstream oss;
-    oss << pos;
-    std::string posString = oss.str();
-    return ((os << posString.size()) && (os << separator) && (os << posString) && (os << separator));
+    for (CExprPtr &arg : m_args)
+    {
+        arg->updateRef(shift);
+    }
 }
 
-bool CSpreadsheet::saveExpr(std::ostream &os, const CExpr &expr) const
+void Aggregate::print(std::ostream &os, const CCellShift &origin) const
 {
-    std::ostringstream oss;
-    oss << expr;
-    std::string resultExpr = oss.str();
-    return ((os << resultExpr.size() + 1) && (os << separator) && (os << "=") && (os << resultExpr) && (os << separator));
+    os << CAggregator::nameOf(m_kind) << "(";
+    for (size_t i = 0; i < m_args.size(); i++)
+    {
+        os << (i ? ", " : "");
+        m_args[i]->print(os, origin);
+    }
+    os << ")";
 }
 
-bool CSpreadsheet::setCell(CPos pos, std::string contents)
+// Conditional
+
+namespace
 {
-    std::shared_ptr<CExpr> cell;
-    try
+    struct CConditionalName
     {
-        cell = setValue(contents);
-    }
-    catch (std::invalid_argument &e)
+        const char *m_name;
+        CConditionalKind m_kind;
+        size_t m_minArgs;
+        size_t m_maxArgs;
+    };
+
+    constexpr std::array<CConditionalName, 5> CONDITIONALS = {{{"IF", CConditionalKind::IF, 2, 3},
+                                                               {"AND", CConditionalKind::AND, 1, SIZE_MAX},
+                                                               {"OR", CConditionalKind::OR, 1, SIZE_MAX},
+                                                               {"CHOOSE", CConditionalKind::CHOOSE, 2, SIZE_MAX},
+                                                               {"IFERROR", CConditionalKind::IFERROR, 2, 2}}};
+}
+
+Conditional::Conditional(CConditionalKind kind, std::vector<CExprPtr> args)
+    : m_kind(kind), m_args(std::move(args)) {}
+
+CExprPtr Conditional::clone(CNodeArena *arena) const
+{
+    std::vector<CExprPtr> args;
+    args.reserve(m_args.size());
+    for (const CExprPtr &arg : m_args)
+    {
+        args.push_back(arg->clone(arena));
+    }
+    return makeNode<Conditional>(arena, m_kind, std::move(args));
+}
+
+CContent Conditional::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    CContent first = m_args[0]->eval(sheet, origin);
+    if (m_kind == CConditionalKind::IFERROR)
+    {
+        return first.isMonostate() ? m_args[1]->eval(sheet, origin) : first;
+    }
+    if (!first.isDouble())
+    {
+        return CContent();
+    }
+    switch (m_kind)
+    {
+    case CConditionalKind::IF:
+        if (first.getDouble() != 0)
+        {
+            return m_args[1]->eval(sheet, origin);
+        }
+        return m_args.size() > 2 ? m_args[2]->eval(sheet, origin) : CContent(0.0);
+    case CConditionalKind::AND:
+    case CConditionalKind::OR:
+    {
+        // the first argument deciding the result stops the evaluation, AND stops at 0 and OR at anything else
+        bool stopAt = m_kind == CConditionalKind::OR;
+        for (size_t i = 0;; i++)
+        {
+            if ((first.getDouble() != 0) == stopAt)
+            {
+                return CContent(stopAt ? 1.0 : 0.0);
+            }
+            if (i + 1 == m_args.size())
+            {
+                return CContent(stopAt ? 0.0 : 1.0);
+            }
+            first = m_args[i + 1]->eval(sheet, origin);
+            if (!first.isDouble())
+            {
+                return CContent();
+            }
+        }
+    }
+    case CConditionalKind::CHOOSE:
+    {
+        double n = std::trunc(first.getDouble());
+        if (n >= 1 && n < m_args.size())
+        {
+            return m_args[static_cast<size_t>(n)]->eval(sheet, origin);
+        }
+        return CContent();
+    }
+    default:
+        return CContent();
+    }
+}
+
+void Conditional::compile(CProgram &program) const
+{
+    m_args[0]->compile(program);
+    if (m_kind == CConditionalKind::IFERROR)
+    {
+        size_t hasValue = program.emitJump(COp::JUMP_IF_VALUE);
+        m_args[1]->compile(program);
+        program.patchJump(hasValue);
+        return;
+    }
+    if (m_kind == CConditionalKind::CHOOSE)
+    {
+        uint32_t caseCount = static_cast<uint32_t>(m_args.size() - 1);
+        size_t select = program.emitSelect(caseCount);
+        std::vector<size_t> toEnd;
+        for (uint32_t i = 0; i < caseCount; i++)
+        {
+            program.patchSelect(select, i);
+            m_args[i + 1]->compile(program);
+            toEnd.push_back(program.emitJump(COp::JUMP));
+        }
+        program.patchSelect(select, caseCount);
+        for (size_t jump : toEnd)
+        {
+            program.patchJump(jump);
+        }
+        return;
+    }
+
+    // every argument is checked to be a number, then tested. IF jumps to else, AND to 0 and OR to 1 when
+    // the test passes, falling through means taking then or going on to the next argument
+    std::vector<size_t> toEnd;
+    std::vector<size_t> toOther;
+    COp test = m_kind == CConditionalKind::OR ? COp::JUMP_IF_TRUE : COp::JUMP_IF_FALSE;
+    size_t tested = m_kind == CConditionalKind::IF ? 1 : m_args.size();
+    for (size_t i = 0; i < tested; i++)
+    {
+        if (i)
+        {
+            m_args[i]->compile(program);
+        }
+        toEnd.push_back(program.emitJump(COp::JUMP_IF_NOT_NUMBER));
+        toOther.push_back(program.emitJump(test));
+    }
+    if (m_kind == CConditionalKind::IF)
+    {
+        m_args[1]->compile(program);
+    }
+    else
+    {
+        program.emitConstant(CContent(m_kind == CConditionalKind::AND ? 1.0 : 0.0));
+    }
+    toEnd.push_back(program.emitJump(COp::JUMP));
+    for (size_t jump : toOther)
+    {
+        program.patchJump(jump);
+    }
+    if (m_kind == CConditionalKind::IF && m_args.size() > 2)
+    {
+        m_args[2]->compile(program);
+    }
+    else
+    {
+        program.emitConstant(CContent(m_kind == CConditionalKind::OR ? 1.0 : 0.0));
+    }
+    for (size_t jump : toEnd)
+    {
+        program.patchJump(jump);
+    }
+}
+
+bool Conditional::isConstant() const
+{
+    return std::all_of(m_args.begin(), m_args.end(), [](const CExprPtr &arg)
+                       { return arg->isConstant(); });
+}
+
+void Conditional::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    // only the first argument is always evaluated
+    m_args[0]->getDependencies(dependencies, origin);
+    bool wasConditional = dependencies.m_isConditional;
+    dependencies.m_isConditional = true;
+    for (size_t i = 1; i < m_args.size(); i++)
+    {
+        m_args[i]->getDependencies(dependencies, origin);
+    }
+    dependencies.m_isConditional = wasConditional;
+}
+
+void Conditional::updateRef(const CCellShift &shift)
+{
+    for (CExprPtr &arg : m_args)
+    {
+        arg->updateRef(shift);
+    }
+}
+
+void Conditional::print(std::ostream &os, const CCellShift &origin) const
+{
+    for (const CConditionalName &function : CONDITIONALS)
+    {
+        if (function.m_kind == m_kind)
+        {
+            os << function.m_name;
+        }
+    }
+    os << "(";
+    for (size_t i = 0; i < m_args.size(); i++)
+    {
+        os << (i ? ", " : "");
+        m_args[i]->print(os, origin);
+    }
+    os << ")";
+}
+
+std::optional<CConditionalKind> Conditional::kindOf(std::string_view name, size_t argCount)
+{
+    std::string upper(name);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char ch)
+                   { return std::toupper(ch); });
+    for (const CConditionalName &function : CONDITIONALS)
+    {
+        if (upper != function.m_name)
+        {
+            continue;
+        }
+        if (argCount < function.m_minArgs || argCount > function.m_maxArgs)
+        {
+            throw std::invalid_argument("wrong number of arguments of " + upper);
+        }
+        return function.m_kind;
+    }
+    return std::nullopt;
+}
+
+// Lookup
+
+namespace
+{
+    struct CLookupName
+    {
+        const char *m_name;
+        CLookupKind m_kind;
+        size_t m_minArgs;
+        size_t m_maxArgs;
+    };
+
+    constexpr std::array<CLookupName, 3> LOOKUPS = {{{"VLOOKUP", CLookupKind::VLOOKUP, 3, 4},
+                                                     {"MATCH", CLookupKind::MATCH, 2, 3},
+                                                     {"COUNTIF", CLookupKind::COUNTIF, 2, 2}}};
+}
+
+Lookup::Lookup(CLookupKind kind, std::vector<CExprPtr> args)
+    : m_kind(kind), m_args(std::move(args))
+{
+    if (!dynamic_cast<const Range *>(m_args[rangeArg()].get()))
+    {
+        throw std::invalid_argument("lookup needs a range");
+    }
+}
+
+CExprPtr Lookup::clone(CNodeArena *arena) const
+{
+    std::vector<CExprPtr> args;
+    args.reserve(m_args.size());
+    for (const CExprPtr &arg : m_args)
+    {
+        args.push_back(arg->clone(arena));
+    }
+    return makeNode<Lookup>(arena, m_kind, std::move(args));
+}
+
+CContent Lookup::eval(const CSpreadsheet &sheet, const CCellShift &origin) const
+{
+    std::vector<CContent> values;
+    for (size_t i = 0; i < m_args.size(); i++)
+    {
+        if (i != rangeArg())
+        {
+            values.push_back(m_args[i]->eval(sheet, origin));
+        }
+    }
+    std::optional<CCellRange> range = static_cast<const Range *>(m_args[rangeArg()].get())->at(origin);
+    return range ? sheet.lookup(m_kind, *range, values) : CContent();
+}
+
+void Lookup::compile(CProgram &program) const
+{
+    const Range *range = static_cast<const Range *>(m_args[rangeArg()].get());
+    if (range->isOffSheet())
+    {
+        program.emitConstant(CContent());
+        return;
+    }
+    for (size_t i = 0; i < m_args.size(); i++)
+    {
+        if (i != rangeArg())
+        {
+            m_args[i]->compile(program);
+        }
+    }
+    range->compileRange(program);
+    program.emitLookup(m_kind, static_cast<uint32_t>(m_args.size() - 1));
+}
+
+bool Lookup::isConstant() const
+{
+    return false;
+}
+
+void Lookup::getDependencies(CDependencies &dependencies, const CCellShift &origin) const
+{
+    for (const CExprPtr &arg : m_args)
+    {
+        arg->getDependencies(dependencies, origin);
+    }
+}
+
+void Lookup::updateRef(const CCellShift &shift)
+{
+    for (CExprPtr &arg : m_args)
+    {
+        arg->updateRef(shift);
+    }
+}
+
+void Lookup::print(std::ostream &os, const CCellShift &origin) const
+{
+    for (const CLookupName &function : LOOKUPS)
+    {
+        if (function.m_kind == m_kind)
+        {
+            os << function.m_name;
+        }
+    }
+    os << "(";
+    for (size_t i = 0; i < m_args.size(); i++)
+    {
+        os << (i ? ", " : "");
+        m_args[i]->print(os, origin);
+    }
+    os << ")";
+}
+
+std::optional<CLookupKind> Lookup::kindOf(std::string_view name, size_t argCount)
+{
+    std::string upper(name);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char ch)
+                   { return std::toupper(ch); });
+    for (const CLookupName &function : LOOKUPS)
+    {
+        if (upper != function.m_name)
+        {
+            continue;
+        }
+        if (argCount < function.m_minArgs || argCount > function.m_maxArgs)
+        {
+            throw std::invalid_argument("wrong number of arguments of " + upper);
+        }
+        return function.m_kind;
+    }
+    return std::nullopt;
+}
+
+size_t Lookup::rangeArg() const
+{
+    return m_kind == CLookupKind::COUNTIF ? 0 : 1;
+}
+
+// CSpreadsheet
+
+CSpreadsheet::CSpreadsheet() : m_arena(new CNodeArena()), m_strings(std::make_shared<CStringPool>()) {}
+
+CSpreadsheet::CSpreadsheet(const CSpreadsheet &other)
+    : m_arena(new CNodeArena()), m_strings(other.m_strings), m_literals(other.m_literals), m_cache(other.m_cache), m_cyclic(other.m_cyclic),
+      m_dependencies(other.m_dependencies), m_dependents(other.m_dependents), m_rangeDependencies(other.m_rangeDependencies),
+      m_rangeReaders(other.m_rangeReaders), m_wideRangeReaders(other.m_wideRangeReaders), m_conditionalDependencies(other.m_conditionalDependencies)
+{
+    // the copy gets its own nodes, so each sheet only ever touches its own arena
+    m_isIndexed = other.m_isIndexed;
+    other.m_table.forEach([&](const CCellKey &pos, const CCell &cell)
+                          { m_table.assign(pos, cell); });
+    cloneFormulas(m_arena.get());
+}
+
+CSpreadsheet &CSpreadsheet::operator=(const CSpreadsheet &other)
+{
+    if (this != &other)
+    {
+        *this = CSpreadsheet(other);
+    }
+    return *this;
+}
+
+bool CSpreadsheet::load(std::istream &is)
+{
+    if (!is.good())
+        return false;
+
+    m_table.clear();
+    m_literals.clear();
+    clearCache();
+    m_lookups.clear();
+    m_cyclic.clear();
+    m_dependencies.clear();
+    m_dependents.clear();
+    m_rangeDependencies.clear();
+    m_conditionalDependencies.clear();
+    m_rangeReaders.clear();
+    m_wideRangeReaders.clear();
+    size_t cellCount = 0;
+    if (!(is >> cellCount))
+        return false;
+
+    if (is.get() != separator)
+        return false;
+
+    for (size_t i = 0; i < cellCount; i++)
+    {
+        std::string posInput;
+        if (!loadString(is, posInput))
+            return false;
+
+        std::string exprInput;
+        if (!loadString(is, exprInput))
+            return false;
+
+        // cycle statuses are found for all cells at once at the end
+        try
+        {
+            putText(CCellKey(CPos(posInput)), exprInput);
+        }
+        catch (std::invalid_argument &e)
+        {
+            return false;
+        }
+    }
+    if (is.get() != EOF)
+        return false;
+
+    classifyCycles();
+    return true;
+}
+
+bool CSpreadsheet::loadChars(size_t count, std::string &buffer, std::istream &is) const
+{
+    char ch;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!is.get(ch))
+        {
+            return false;
+        }
+        else
+        {
+            buffer += ch;
+        }
+    }
+    return true;
+}
+
+bool CSpreadsheet::loadString(std::istream &is, std::string &out) const
+{
+    size_t size = 0;
+    if (!(is >> size))
+        return false;
+    if (is.get() != separator)
+        return false;
+    if (!loadChars(size, out, is))
+        return false;
+    if (is.get() != separator)
+        return false;
+    return true;
+}
+
+bool CSpreadsheet::save(std::ostream &os) const
+{
+    //[cellCount]|[posSize]|[pos]|[exprSize]=[expr]|...|
+
+    if (!(os << m_table.size() + m_literals.size()))
+        return false;
+    if (!(os << separator))
+        return false;
+    bool ok = true;
+    m_table.forEach([&](const CCellKey &pos, const CCell &cell)
+                    { ok = ok && savePos(os, pos) && saveExpr(os, *cell.m_formula->m_expr, cell.m_origin); });
+    m_literals.forEach([&](const CCellKey &pos, const CContent &value)
+                       { ok = ok && savePos(os, pos) && saveExpr(os, Literal(value), CCellShift()); });
+    return ok && os.good();
+}
+
+bool CSpreadsheet::savePos(std::ostream &os, const CCellKey &pos) const
+{
+    std::ostringstream oss;
+    oss << pos.toPos();
+    std::string posString = oss.str();
+    return ((os << posString.size()) && (os << separator) && (os << posString) && (os << separator));
+}
+
+bool CSpreadsheet::saveExpr(std::ostream &os, const CExpr &expr, const CCellShift &origin) const
+{
+    std::ostringstream oss;
+    expr.print(oss, origin);
+    std::string resultExpr = oss.str();
+    return ((os << resultExpr.size() + 1) && (os << separator) && (os << "=") && (os << resultExpr) && (os << separator));
+}
+
+bool CSpreadsheet::setCell(CPos pos, std::string contents)
+{
+    std::vector<CCellKey> changed;
+    try
+    {
+        changed = putText(CCellKey(pos), contents);
+    }
+    catch (std::invalid_argument &e)
+    {
+        return false;
+    }
+    classify(changed); // classify right away, so reading the cell later is a single lookup
+    return true;
+}
+
+std::vector<CCellKey> CSpreadsheet::putText(const CCellKey &pos, std::string_view input)
+{
+    // plain values are cheaper to parse than to look up
+    if (input.empty() || input[0] != '=')
+    {
+        return putCell(pos, setValue(input));
+    }
+    return putCell(pos, CCell{parseFormula(input), CCellShift()});
+}
+
+std::vector<CCellKey> CSpreadsheet::putCell(const CCellKey &pos, CExprPtr cell)
+{
+    if (cell)
+    {
+        return putCell(pos, CCell{makeFormula(std::move(cell)), CCellShift()});
+    }
+    m_literals.erase(pos);
+    if (m_table.erase(pos))
+    {
+        m_formulaTotals.erase(pos.getCol());
+    }
+    compactArena();
+    updateDependencies(pos);
+    return invalidate(pos);
+}
+
+std::vector<CCellKey> CSpreadsheet::putCell(const CCellKey &pos, CCell cell)
+{
+    const Literal *literal = dynamic_cast<const Literal *>(cell.m_formula->m_expr.get());
+    if (literal && (literal->getValue().isDouble() || literal->getValue().isString()))
+    {
+        return putLiteral(pos, literal->getValue());
+    }
+    m_literals.erase(pos);
+    if (!m_table.contains(pos))
+    {
+        m_formulaTotals.erase(pos.getCol());
+    }
+    m_table.assign(pos, std::move(cell));
+    compactArena();
+    updateDependencies(pos);
+    return invalidate(pos);
+}
+
+std::shared_ptr<const CFormula> CSpreadsheet::makeFormula(CExprPtr expr)
+{
+    auto formula = std::make_shared<CFormula>();
+    expr->compile(formula->m_program);
+    formula->m_expr = std::move(expr);
+    return formula;
+}
+
+std::vector<CCellKey> CSpreadsheet::putLiteral(const CCellKey &pos, const CContent &value)
+{
+    m_literals.assign(pos, value);
+    if (m_table.erase(pos))
+    {
+        m_formulaTotals.erase(pos.getCol());
+    }
+    compactArena();
+    updateDependencies(pos);
+    return invalidate(pos);
+}
+
+void CSpreadsheet::compactArena()
+{
+    if (m_arena->freeBytes() <= CNodeArena::BLOCK_SIZE || m_arena->freeBytes() <= m_arena->liveBytes())
+    {
+        return;
+    }
+    CNodeArenaPtr arena(new CNodeArena());
+    cloneFormulas(arena.get());
+    m_parsed.clear(); // cached formulas would keep the old arena alive
+    m_arena = std::move(arena); // old arena is deleted once nothing uses its nodes
+}
+
+void CSpreadsheet::cloneFormulas(CNodeArena *arena)
+{
+    std::unordered_map<const CFormula *, std::shared_ptr<const CFormula>> copies;
+    m_table.forEach([&](const CCellKey &, CCell &cell)
+                    {
+        std::shared_ptr<const CFormula> &copy = copies[cell.m_formula.get()];
+        if (!copy)
+        {
+            copy = std::make_shared<CFormula>(CFormula{cell.m_formula->m_expr->clone(arena), cell.m_formula->m_program});
+        }
+        cell.m_formula = copy; });
+}
+
+bool CSpreadsheet::isCycle(const CCellKey &start) const
+{
+    if (!m_table.contains(start))
+    {
+        return false; // cell without formula reads nothing
+    }
+    auto known = m_cyclic.find(start);
+    if (known == m_cyclic.end())
+    {
+        classify({start});
+        known = m_cyclic.find(start);
+    }
+    return known->second;
+}
+
+void CSpreadsheet::classifyCycles() const
+{
+    std::vector<CCellKey> cells;
+    cells.reserve(m_table.size());
+    m_table.forEach([&](const CCellKey &pos, const CCell &)
+                    { cells.push_back(pos); });
+    classify(cells);
+}
+
+void CSpreadsheet::classify(const std::vector<CCellKey> &starts) const
+{
+    // cells with known status are leaves of the search, every other cell visited gets index and lowlink.
+    // a component is finished only after all components it reads, so when it is popped the status of
+    // everything outside of it is known - it is cyclic if it has more than one cell, a self loop,
+    // or reads a cyclic cell
+    struct Frame
+    {
+        CCellKey pos;
+        std::vector<CCellKey> dependencies;
+        size_t next = 0;
+    };
+    std::unordered_map<CCellKey, std::pair<size_t, size_t>, CCellKeyHasher> indexes; // index, lowlink
+    std::vector<CCellKey> component;
+    std::vector<Frame> frames;
+    size_t counter = 0;
+
+    auto enter = [&](const CCellKey &pos)
+    {
+        indexes.insert({pos, {counter, counter}});
+        counter++;
+        component.push_back(pos);
+        frames.push_back({pos, formulaDependencies(pos)});
+    };
+
+    for (const auto &start : starts)
+    {
+        if (m_cyclic.contains(start) || indexes.contains(start) || !m_table.contains(start))
+        {
+            continue;
+        }
+        enter(start);
+        while (!frames.empty())
+        {
+            CCellKey current = frames.back().pos;
+            if (frames.back().next != frames.back().dependencies.size())
+            {
+                CCellKey dependency = frames.back().dependencies[frames.back().next++];
+                if (m_cyclic.contains(dependency)) // cells without formula are never cyclic, they arent listed
+                {
+                    continue;
+                }
+                auto visited = indexes.find(dependency);
+                if (visited == indexes.end())
+                {
+                    enter(dependency);
+                }
+                else // not finished yet => still on the component stack
+                {
+                    size_t &lowlink = indexes.find(current)->second.second;
+                    lowlink = std::min(lowlink, visited->second.first);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            auto [index, lowlink] = indexes.find(current)->second;
+            if (!frames.empty())
+            {
+                size_t &parentLowlink = indexes.find(frames.back().pos)->second.second;
+                parentLowlink = std::min(parentLowlink, lowlink);
+            }
+            if (lowlink != index)
+            {
+                continue;
+            }
+
+            auto first = std::find(component.rbegin(), component.rend(), current).base() - 1;
+            bool cyclic = component.end() - first > 1;
+            for (auto member = first; member != component.end() && !cyclic; member++)
+            {
+                for (const auto &dependency : formulaDependencies(*member))
+                {
+                    auto status = m_cyclic.find(dependency);
+                    if (dependency == *member || (status != m_cyclic.end() && status->second))
+                    {
+                        cyclic = true;
+                        break;
+                    }
+                }
+            }
+            for (auto member = first; member != component.end(); member++)
+            {
+                m_cyclic.insert({*member, cyclic});
+            }
+            component.erase(first, component.end());
+        }
+    }
+}
+
+std::vector<std::vector<CCellKey>> CSpreadsheet::evaluationLevels() const
+{
+    // Kahn's algorithm, only cells with formula count since other cells need no evaluation
+    std::unordered_map<CCellKey, size_t, CCellKeyHasher> waitingFor;
+    std::unordered_map<CCellKey, std::vector<CCellKey>, CCellKeyHasher> readers;
+    std::vector<std::vector<CCellKey>> levels(1);
+    m_table.forEach([&](const CCellKey &pos, const CCell &)
+                    {
+        if (m_cyclic.find(pos)->second)
+        {
+            return;
+        }
+        std::vector<CCellKey> dependencies = formulaDependencies(pos);
+        for (const auto &dependency : dependencies)
+        {
+            readers[dependency].push_back(pos);
+        }
+        if (dependencies.empty())
+        {
+            levels.back().push_back(pos);
+        }
+        else
+        {
+            waitingFor.insert({pos, dependencies.size()});
+        } });
+    while (!levels.back().empty())
     {
-        return false;
+        std::vector<CCellKey> next;
+        for (const auto &pos : levels.back())
+        {
+            auto dependents = readers.find(pos);
+            if (dependents == readers.end())
+            {
+                continue;
+            }
+            for (const auto &dependent : dependents->second)
+            {
+                auto waiting = waitingFor.find(dependent);
+                if (waiting != waitingFor.end() && --waiting->second == 0)
+                {
+                    next.push_back(dependent);
+                }
+            }
+        }
+        levels.push_back(std::move(next));
     }
-    if (m_table.contains(pos))
+    levels.pop_back();
+    return levels;
+}
+
+std::vector<std::pair<CPos, CValue>> CSpreadsheet::recalculateAll(unsigned threadCount)
+{
+    clearCache();
+    classifyCycles();
+    std::vector<std::vector<CCellKey>> levels = evaluationLevels();
+    if (threadCount > 1)
     {
-        m_table.find(pos)->second = cell;
+        m_isEvaluatingInParallel = true;
+        evalLevelsParallel(levels, threadCount);
+        m_isEvaluatingInParallel = false;
     }
-    m_table.insert({pos, cell});
-    return true;
+    else
+    {
+        for (const auto &level : levels)
+        {
+            for (const auto &pos : level)
+            {
+                evalCell(pos); // everything pos reads is already cached
+            }
+        }
+    }
+
+    std::vector<CCellKey> cells;
+    cells.reserve(m_table.size() + m_literals.size());
+    m_table.forEach([&](const CCellKey &pos, const CCell &)
+                    { cells.push_back(pos); });
+    m_literals.forEach([&](const CCellKey &pos, const CContent &)
+                       { cells.push_back(pos); });
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<std::pair<CPos, CValue>> values;
+    values.reserve(cells.size());
+    for (const auto &pos : cells)
+    {
+        if (std::optional<CContent> literal = m_literals.find(pos))
+        {
+            values.push_back({pos.toPos(), literal->toValue()});
+            continue;
+        }
+        auto cached = m_cache.find(pos);
+        values.push_back({pos.toPos(), cached == m_cache.end() ? CValue() : cached->second.toValue()});
+    }
+    return values;
 }
 
-bool CSpreadsheet::isCycle(const CPos &start) const
+void CSpreadsheet::evalLevelsParallel(const std::vector<std::vector<CCellKey>> &levels, unsigned threadCount)
 {
-    const int ENTER = 0;
-    const int EXIT = 1;
-    std::vector<std::pair<CPos, int>> stack;
-    std::unordered_set<CPos, CPosHasher> visiting;
-    std::unordered_set<CPos, CPosHasher> visited;
-    stack.push_back({start, ENTER});
-    while (!stack.empty())
+    // threads take cells of the current level through a shared counter and only read the cache, as everything
+    // the level reads is cached already. Results are moved to the cache by the barrier completion, which runs
+    // once all threads finished the level and before any of them continues with the next one
+    size_t level = 0;
+    std::atomic<size_t> next = 0;
+    std::vector<CContent> results(levels.empty() ? 0 : levels[0].size());
+    auto commit = [&]() noexcept
     {
-        std::pair<CPos, int> current = stack.back();
-        stack.pop_back();
-        if (current.second == EXIT)
+        for (size_t i = 0; i < results.size(); i++)
         {
-            visiting.erase(current.first);
-            visited.insert(current.first);
+            cacheValue(levels[level][i], m_strings->intern(results[i]));
         }
-        else
+        level++;
+        next = 0;
+        results.assign(level < levels.size() ? levels[level].size() : 0, CContent());
+    };
+    std::barrier sync(threadCount, commit);
+    auto work = [&]()
+    {
+        while (level < levels.size())
         {
-            visiting.insert(current.first);
-            stack.push_back({current.first, EXIT});
-            std::unordered_set<CPos, CPosHasher> dependencies;
-            getCell(current.first)->getDependencies(dependencies);
-            for (const auto &nodeTopush : dependencies)
+            const std::vector<CCellKey> &cells = levels[level];
+            for (size_t i = next++; i < cells.size(); i = next++)
             {
-                if (visiting.contains(nodeTopush))
-                {
-                    return true;
-                }
-                else if (!visiting.contains(nodeTopush) && !visited.contains(nodeTopush))
-                {
-                    stack.push_back({nodeTopush, ENTER});
-                }
+                const CCell *cell = m_table.find(cells[i]);
+                results[i] = cell->m_formula->m_program.run(*this, cell->m_origin);
             }
+            sync.arrive_and_wait();
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &thread : threads)
+    {
+        thread.join();
     }
-    return false;
 }
 
-std::shared_ptr<CExpr> CSpreadsheet::setValue(std::string input)
+CExprPtr CSpreadsheet::setValue(std::string_view input)
 {
-    CAstBuilder builder;
-    parseExpression(input, builder);
+    CAstBuilder builder(m_arena.get(), m_strings.get());
+    CParser::parse(input, builder);
     return builder.getResult();
 }
 
-CValue CSpreadsheet::getValue(CPos pos)
+std::shared_ptr<const CFormula> CSpreadsheet::parseFormula(std::string_view input)
 {
+    std::shared_ptr<const CFormula> formula = m_parsed.find(input);
+    if (!formula)
+    {
+        formula = makeFormula(setValue(input));
+        m_parsed.insert(input, formula);
+    }
+    return formula;
+}
 
-    std::shared_ptr<CExpr> cellToEval = getCell(pos);
-    if (isCycle(pos))
+CValue CSpreadsheet::getValue(CPos pos)
+{
+    if (pos.m_row > CCellKey::MAX_INDEX || pos.m_col > CCellKey::MAX_INDEX)
+    {
+        return CValue(); // no cell can be stored there
+    }
+    CCellKey key(pos);
+    if (isCycle(key))
     {
         return CValue();
     }
-    return cellToEval->eval(*this).m_value;
+    return evalCell(key).toValue();
 }
 
-void CSpreadsheet::copyRect(CPos dst, CPos src, int w, int h)
+CContent CSpreadsheet::evalCell(const CCellKey &pos) const
 {
-    std::unordered_map<CPos, std::shared_ptr<CExpr>, CPosHasher> cellsToInsert; // copies of cells to be inserted
-    std::pair<int, int> shift = {dst.m_row - src.m_row, dst.m_col - src.m_col};
-    for (int i = 0; i < h; i++)
+    auto cached = m_cache.find(pos);
+    if (cached != m_cache.end())
     {
-        for (int j = 0; j < w; j++)
-        {
-            // old pos
-            CPos from = src;
-            from.shiftBy(i, j);
-
-            // new pos
-            CPos to = dst;
-            to.shiftBy(i, j);
+        return cached->second;
+    }
+    if (std::optional<CContent> literal = m_literals.find(pos))
+    {
+        return *literal; // plain values arent cached, they are stored as they are
+    }
+    const CCell *cell = m_table.find(pos);
+    if (!cell)
+    {
+        return CContent(); // empty cells arent cached, they are cheap to eval
+    }
+    CContent result = m_strings->intern(cell->m_formula->m_program.run(*this, cell->m_origin)); // cached strings share text with equal ones
+    cacheValue(pos, result);
+    return result;
+}
 
-            if (m_table.contains(from))
+void CSpreadsheet::aggregate(const CCellRange &range, CAggregator &aggregator) const
+{
+    size_t w = range.getWidth();
+    size_t h = range.getHeight();
+    m_literals.aggregate(range.m_first, w, h, aggregator, m_isEvaluatingInParallel);
+    auto addCell = [&](const CCellKey &pos, const CCell &)
+    {
+        aggregator.add(evalCell(pos));
+    };
+    if (!m_isIndexed || !aggregator.isAdditive() || w > CColumnTotals::MAX_COLS || h < CColumnTotals::MIN_ROWS)
+    {
+        m_table.forEachIn(range.m_first, w, h, addCell);
+        return;
+    }
+    size_t first = range.m_first.getRow();
+    size_t last = range.m_last.getRow();
+    for (size_t col = range.m_first.getCol(); col <= range.m_last.getCol(); col++)
+    {
+        const CColumnTotals *totals = formulaTotalsOf(col);
+        if (!totals)
+        {
+            m_table.forEachIn(CCellKey(first, col), 1, h, addCell);
+            continue;
+        }
+        CTotals part = totals->query(first, last);
+        if (part.m_unknown)
+        {
+            // caching the values of the cells updates the index
+            std::vector<size_t> unknown;
+            totals->forEachUnknown(first, last, [&](size_t row)
+                                   { unknown.push_back(row); });
+            for (size_t row : unknown)
             {
-                std::shared_ptr<CExpr> copyOfExpr = m_table.find(from)->second->clone();
-                copyOfExpr->updateRef(shift.first, shift.second);
-                cellsToInsert.insert({to, copyOfExpr});
+                evalCell(CCellKey(row, col));
             }
+            part = totals->query(first, last);
+        }
+        aggregator.addTotals(part);
+    }
+}
+
+CContent CSpreadsheet::lookup(CLookupKind kind, const CCellRange &range, std::span<const CContent> values) const
+{
+    // only exact matches are supported, the optional last argument asks for them by 0
+    size_t exactArg = kind == CLookupKind::VLOOKUP ? 2 : 1;
+    if (kind != CLookupKind::COUNTIF && values.size() > exactArg &&
+        !(values[exactArg].isDouble() && values[exactArg].getDouble() == 0))
+    {
+        return CContent();
+    }
+    const CContent &key = values[0];
+    switch (kind)
+    {
+    case CLookupKind::COUNTIF:
+        return CContent(double(lookupIn(range, key).m_count));
+    case CLookupKind::MATCH:
+    {
+        if (range.getWidth() != 1 && range.getHeight() != 1)
+        {
+            return CContent();
+        }
+        CLookupIndex::CMatch match = lookupIn(range, key);
+        return match.m_count ? CContent(double(match.m_first + 1)) : CContent();
+    }
+    case CLookupKind::VLOOKUP:
+    {
+        if (!values[1].isDouble())
+        {
+            return CContent();
+        }
+        double col = std::trunc(values[1].getDouble());
+        if (!(col >= 1 && col <= range.getWidth()))
+        {
+            return CContent();
         }
+        CLookupIndex::CMatch match = lookupIn(CCellRange(range.m_first, CCellKey(range.m_last.getRow(), range.m_first.getCol())), key);
+        if (!match.m_count)
+        {
+            return CContent();
+        }
+        return evalCell(range.m_first.shiftedBy(static_cast<int>(match.m_first), static_cast<int>(col) - 1));
+    }
+    default:
+        return CContent();
+    }
+}
+
+CLookupIndex::CMatch CSpreadsheet::lookupIn(const CCellRange &range, const CContent &key) const
+{
+    if (std::optional<CLookupIndex::CMatch> match = m_lookups.find(range, key))
+    {
+        return *match;
+    }
+    // while evaluating in parallel, everything range holds is cached already, so building the index only reads
+    CLookupIndex index;
+    size_t w = range.getWidth();
+    size_t h = range.getHeight();
+    auto offsetOf = [&](const CCellKey &pos)
+    {
+        return (pos.getRow() - range.m_first.getRow()) * w + (pos.getCol() - range.m_first.getCol());
+    };
+    m_literals.forEachIn(range.m_first, w, h, [&](const CCellKey &pos, const CContent &value)
+                         { index.add(value, offsetOf(pos)); });
+    m_table.forEachIn(range.m_first, w, h, [&](const CCellKey &pos, const CCell &)
+                      { index.add(evalCell(pos), offsetOf(pos)); });
+    CLookupIndex::CMatch match = index.find(key);
+    m_lookups.insert(range, std::move(index));
+    return match;
+}
+
+void CSpreadsheet::setColumnIndexes(bool enabled)
+{
+    m_isIndexed = enabled;
+    m_literals.setIndexed(enabled);
+    m_formulaTotals.clear();
+}
+
+void CSpreadsheet::cacheValue(const CCellKey &pos, const CContent &value) const
+{
+    m_cache.insert({pos, value});
+    auto totals = m_formulaTotals.find(pos.getCol());
+    if (totals != m_formulaTotals.end())
+    {
+        totals->second.update(pos.getRow(), CTotals::of(value));
+    }
+}
+
+bool CSpreadsheet::uncacheValue(const CCellKey &pos) const
+{
+    if (!m_cache.erase(pos))
+    {
+        return false;
+    }
+    m_lookups.drop(pos);
+    auto totals = m_formulaTotals.find(pos.getCol());
+    if (totals != m_formulaTotals.end())
+    {
+        totals->second.update(pos.getRow(), CTotals::of(CContent(), false));
+    }
+    return true;
+}
+
+void CSpreadsheet::clearCache()
+{
+    m_cache.clear();
+    m_formulaTotals.clear();
+}
+
+const CColumnTotals *CSpreadsheet::formulaTotalsOf(size_t col) const
+{
+    auto totals = m_formulaTotals.find(col);
+    if (totals != m_formulaTotals.end())
+    {
+        return &totals->second;
+    }
+    if (m_isEvaluatingInParallel)
+    {
+        return nullptr;
     }
-    insertCellsTo(dst, w, h, cellsToInsert);
+    std::vector<std::pair<size_t, CTotals>> items;
+    m_table.forEachIn(CCellKey(0, col), 1, CCellKey::MAX_INDEX + 1, [&](const CCellKey &pos, const CCell &)
+                      {
+        auto cached = m_cache.find(pos);
+        items.push_back({pos.getRow(), cached == m_cache.end() ? CTotals::of(CContent(), false) : CTotals::of(cached->second)}); });
+    std::sort(items.begin(), items.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+    return &m_formulaTotals.emplace(col, CColumnTotals(items)).first->second;
 }
 
-void CSpreadsheet::insertCellsTo(const CPos &dst, const int w, const int h, const std::unordered_map<CPos, std::shared_ptr<CExpr>, CPosHasher> &cellsToInsert)
+const std::unordered_set<CCellKey, CCellKeyHasher> &CSpreadsheet::getDependencies(const CCellKey &pos) const
 {
-    for (int i = 0; i < h; i++)
+    static const std::unordered_set<CCellKey, CCellKeyHasher> none;
+    auto it = m_dependencies.find(pos);
+    return it == m_dependencies.end() ? none : it->second;
+}
+
+const std::vector<CCellRange> &CSpreadsheet::getRangeDependencies(const CCellKey &pos) const
+{
+    static const std::vector<CCellRange> none;
+    auto it = m_rangeDependencies.find(pos);
+    return it == m_rangeDependencies.end() ? none : it->second;
+}
+
+const CDependencies &CSpreadsheet::getConditionalDependencies(const CCellKey &pos) const
+{
+    static const CDependencies none;
+    auto it = m_conditionalDependencies.find(pos);
+    return it == m_conditionalDependencies.end() ? none : it->second;
+}
+
+const std::unordered_set<CCellKey, CCellKeyHasher> &CSpreadsheet::getDependents(const CCellKey &pos) const
+{
+    static const std::unordered_set<CCellKey, CCellKeyHasher> none;
+    auto it = m_dependents.find(pos);
+    return it == m_dependents.end() ? none : it->second;
+}
+
+void CSpreadsheet::updateDependencies(const CCellKey &pos)
+{
+    auto old = m_dependencies.find(pos);
+    if (old != m_dependencies.end())
+    {
+        for (const auto &dependency : old->second)
+        {
+            auto readers = m_dependents.find(dependency);
+            readers->second.erase(pos);
+            if (readers->second.empty())
+            {
+                m_dependents.erase(readers);
+            }
+        }
+        m_dependencies.erase(old);
+    }
+    auto oldRanges = m_rangeDependencies.find(pos);
+    if (oldRanges != m_rangeDependencies.end())
+    {
+        for (const auto &range : oldRanges->second)
+        {
+            if (isWideRange(range))
+            {
+                std::erase_if(m_wideRangeReaders, [&](const auto &reader)
+                              { return reader.second == pos; });
+                continue;
+            }
+            for (size_t block = range.m_first.getCol() / RANGE_BLOCK_COLS; block <= range.m_last.getCol() / RANGE_BLOCK_COLS; block++)
+            {
+                // another range of pos in the same block may have emptied it already
+                auto readers = m_rangeReaders.find(block);
+                if (readers == m_rangeReaders.end())
+                {
+                    continue;
+                }
+                std::erase_if(readers->second, [&](const auto &reader)
+                              { return reader.second == pos; });
+                if (readers->second.empty())
+                {
+                    m_rangeReaders.erase(readers);
+                }
+            }
+        }
+        m_rangeDependencies.erase(oldRanges);
+    }
+    m_conditionalDependencies.erase(pos);
+
+    const CCell *cell = m_table.find(pos);
+    if (!cell)
+    {
+        return;
+    }
+    CDependencies dependencies;
+    cell->m_formula->m_expr->getDependencies(dependencies, cell->m_origin);
+    if (!dependencies.m_conditionalCells.empty() || !dependencies.m_conditionalRanges.empty())
+    {
+        CDependencies conditional;
+        conditional.m_conditionalCells = std::move(dependencies.m_conditionalCells);
+        conditional.m_conditionalRanges = std::move(dependencies.m_conditionalRanges);
+        m_conditionalDependencies.insert({pos, std::move(conditional)});
+    }
+    if (!dependencies.m_cells.empty())
+    {
+        for (const auto &dependency : dependencies.m_cells)
+        {
+            m_dependents[dependency].insert(pos);
+        }
+        m_dependencies.insert({pos, std::move(dependencies.m_cells)});
+    }
+    if (!dependencies.m_ranges.empty())
     {
-        for (int j = 0; j < w; j++)
+        // a range read twice is one edge
+        std::sort(dependencies.m_ranges.begin(), dependencies.m_ranges.end(), [](const CCellRange &a, const CCellRange &b)
+                  { return std::pair(a.m_first, a.m_last) < std::pair(b.m_first, b.m_last); });
+        dependencies.m_ranges.erase(std::unique(dependencies.m_ranges.begin(), dependencies.m_ranges.end()), dependencies.m_ranges.end());
+        for (const auto &range : dependencies.m_ranges)
         {
-            CPos to = dst;
-            to.shiftBy(i, j);
-            if (cellsToInsert.contains(to))
+            if (isWideRange(range))
             {
-                m_table[to] = (cellsToInsert.find(to))->second; // insert/rewrite to
+                m_wideRangeReaders.push_back({range, pos});
+                continue;
             }
-            else
+            for (size_t block = range.m_first.getCol() / RANGE_BLOCK_COLS; block <= range.m_last.getCol() / RANGE_BLOCK_COLS; block++)
             {
-                m_table.erase(to); // delete = paste empty cell
+                m_rangeReaders[block].push_back({range, pos});
             }
         }
+        m_rangeDependencies.insert({pos, std::move(dependencies.m_ranges)});
+    }
+}
+
+std::vector<CCellKey> CSpreadsheet::formulaDependencies(const CCellKey &pos) const
+{
+    std::vector<CCellKey> dependencies;
+    for (const auto &dependency : getDependencies(pos))
+    {
+        if (m_table.contains(dependency))
+        {
+            dependencies.push_back(dependency);
+        }
+    }
+    const std::vector<CCellRange> &ranges = getRangeDependencies(pos);
+    if (ranges.empty())
+    {
+        return dependencies;
+    }
+    // only the tiles of the table overlapping a range are visited, not every cell of it
+    for (const auto &range : ranges)
+    {
+        m_table.forEachIn(range.m_first, range.getWidth(), range.getHeight(), [&](const CCellKey &dependency, const CCell &)
+                          { dependencies.push_back(dependency); });
+    }
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    return dependencies;
+}
+
+std::vector<CCellKey> CSpreadsheet::invalidate(const CCellKey &pos)
+{
+    // a cell with cached value or status always has its dependencies cached/classified as well,
+    // so the walk can stop at dependents which have neither
+    std::vector<CCellKey> unclassified = {pos};
+    m_lookups.drop(pos); // plain values arent cached, uncacheValue wouldnt drop their indexes
+    uncacheValue(pos);
+    m_cyclic.erase(pos);
+    std::vector<CCellKey> stack(getDependents(pos).begin(), getDependents(pos).end());
+    forEachRangeReader(pos, [&](const CCellKey &reader)
+                       { stack.push_back(reader); });
+    while (!stack.empty())
+    {
+        CCellKey current = stack.back();
+        stack.pop_back();
+        bool wasCached = uncacheValue(current);
+        bool wasClassified = m_cyclic.erase(current) > 0;
+        if (wasClassified)
+        {
+            unclassified.push_back(current);
+        }
+        if (!wasCached && !wasClassified)
+        {
+            continue;
+        }
+        for (const auto &dependent : getDependents(current))
+        {
+            stack.push_back(dependent);
+        }
+        forEachRangeReader(current, [&](const CCellKey &reader)
+                           { stack.push_back(reader); });
+    }
+    return unclassified;
+}
+
+void CSpreadsheet::copyRect(CPos dst, CPos src, int w, int h)
+{
+    CCellKey dstKey;
+    CCellKey srcKey;
+    try
+    {
+        dstKey = CCellKey(dst);
+        srcKey = CCellKey(src);
+    }
+    catch (std::invalid_argument &e)
+    {
+        return; // rectangles outside of the addressable area
+    }
+
+    if (w <= 0 || h <= 0)
+    {
+        return;
+    }
+    std::vector<std::pair<CCellKey, CCell>> cellsToInsert; // copies of cells to be inserted, sharing formulas of the originals
+    std::vector<std::pair<CCellKey, CContent>> valuesToInsert;
+    CCellShift shift{static_cast<int64_t>(dstKey.getRow()) - static_cast<int64_t>(srcKey.getRow()),
+                     static_cast<int64_t>(dstKey.getCol()) - static_cast<int64_t>(srcKey.getCol())};
+    // cells copied past the last row or col of the sheet are dropped. A copy whose references move off the sheet
+    // gets its own formula with them written as CParser::OFF_SHEET, so they stay off even if it is copied back
+    m_table.forEachIn(srcKey, w, h, [&](const CCellKey &from, const CCell &cell)
+                      {
+        std::optional<CCellKey> to = from.resolvedAt(shift, false, false);
+        if (!to)
+        {
+            return;
+        }
+        CCell copy{cell.m_formula, cell.m_origin.shiftedBy(shift.m_rows, shift.m_cols)};
+        if (!copy.m_formula->m_program.fitsAt(copy.m_origin))
+        {
+            CExprPtr expr = copy.m_formula->m_expr->clone(m_arena.get());
+            expr->updateRef(copy.m_origin);
+            copy = CCell{makeFormula(std::move(expr)), CCellShift()};
+        }
+        cellsToInsert.push_back({*to, std::move(copy)}); });
+    m_literals.forEachIn(srcKey, w, h, [&](const CCellKey &from, const CContent &value)
+                         {
+        if (std::optional<CCellKey> to = from.resolvedAt(shift, false, false))
+        {
+            valuesToInsert.push_back({*to, value});
+        } });
+    insertCellsTo(dstKey, w, h, cellsToInsert, valuesToInsert);
+}
+
+void CSpreadsheet::insertCellsTo(const CCellKey &dst, const int w, const int h, std::vector<std::pair<CCellKey, CCell>> &cellsToInsert,
+                                 const std::vector<std::pair<CCellKey, CContent>> &valuesToInsert)
+{
+    // only cells that are non-empty before or after the paste change, empty cells of the rectangle are skipped
+    std::vector<CCellKey> toDelete;
+    m_table.forEachIn(dst, w, h, [&](const CCellKey &pos, const CCell &)
+                      { toDelete.push_back(pos); });
+    m_literals.forEachIn(dst, w, h, [&](const CCellKey &pos, const CContent &)
+                         { toDelete.push_back(pos); });
+    std::vector<CCellKey> inserted;
+    inserted.reserve(cellsToInsert.size() + valuesToInsert.size());
+    for (const auto &cell : cellsToInsert)
+    {
+        inserted.push_back(cell.first);
     }
+    for (const auto &value : valuesToInsert)
+    {
+        inserted.push_back(value.first);
+    }
+    std::sort(toDelete.begin(), toDelete.end());
+    std::sort(inserted.begin(), inserted.end());
+    toDelete.erase(std::set_difference(toDelete.begin(), toDelete.end(), inserted.begin(), inserted.end(), toDelete.begin()), toDelete.end());
+
+    std::vector<CCellKey> unclassified;
+    for (const auto &pos : toDelete)
+    {
+        std::vector<CCellKey> changed = putCell(pos, nullptr); // delete = paste empty cell
+        unclassified.insert(unclassified.end(), changed.begin(), changed.end());
+    }
+    for (auto &cell : cellsToInsert)
+    {
+        std::vector<CCellKey> changed = putCell(cell.first, std::move(cell.second)); // insert/rewrite
+        unclassified.insert(unclassified.end(), changed.begin(), changed.end());
+    }
+    for (const auto &value : valuesToInsert)
+    {
+        std::vector<CCellKey> changed = putLiteral(value.first, value.second);
+        unclassified.insert(unclassified.end(), changed.begin(), changed.end());
+    }
+    classify(unclassified);
 }
 
-std::shared_ptr<CExpr> CSpreadsheet::getCell(const CPos &pos) const
+CExprPtr CSpreadsheet::getCell(const CPos &pos) const
 {
-    auto it = m_table.find(pos);
-    if (it == m_table.end())
+    if (pos.m_row > CCellKey::MAX_INDEX || pos.m_col > CCellKey::MAX_INDEX)
+    {
+        return makeNode<Literal>(nullptr, CContent());
+    }
+    CCellKey key(pos);
+    if (const CCell *cell = m_table.find(key))
     {
-        CAstBuilder builder;
-        builder.valNull();
-        return builder.getResult();
+        // the copy reads the same cells with origin (0, 0)
+        CExprPtr copy = cell->m_formula->m_expr->clone(nullptr);
+        copy->updateRef(cell->m_origin);
+        return copy;
     }
-    return it->second;
+    return makeNode<Literal>(nullptr, m_literals.find(key).value_or(CContent()));
 }
 
 // CAstBuilder
 void CAstBuilder::opAdd()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Addition>(lhs, rhs));
+    m_stack.push(makeNode<Addition>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opSub()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Subtraction>(lhs, rhs));
+    m_stack.push(makeNode<Subtraction>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opMul()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Multiplication>(lhs, rhs));
+    m_stack.push(makeNode<Multiplication>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opDiv()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Division>(lhs, rhs));
+    m_stack.push(makeNode<Division>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opPow()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Exponentiation>(lhs, rhs));
+    m_stack.push(makeNode<Exponentiation>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opNeg()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Negation>(rhs));
+    m_stack.push(makeNode<Negation>(m_arena, std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opEq()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<Equal>(lhs, rhs));
+    m_stack.push(makeNode<Equal>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opNe()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<NotEqual>(lhs, rhs));
+    m_stack.push(makeNode<NotEqual>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opLt()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<LessThan>(lhs, rhs));
+    m_stack.push(makeNode<LessThan>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opLe()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<LessEqual>(lhs, rhs));
+    m_stack.push(makeNode<LessEqual>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opGt()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<GreaterThan>(lhs, rhs));
+    m_stack.push(makeNode<GreaterThan>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::opGe()
 {
-    std::shared_ptr<CExpr> rhs = m_stack.top();
+    CExprPtr rhs = std::move(m_stack.top());
     m_stack.pop();
-    std::shared_ptr<CExpr> lhs = m_stack.top();
+    CExprPtr lhs = std::move(m_stack.top());
     m_stack.pop();
-    m_stack.push(std::make_shared<GreaterEqual>(lhs, rhs));
+    m_stack.push(makeNode<GreaterEqual>(m_arena, std::move(lhs), std::move(rhs)));
+    foldTop();
 }
 
 void CAstBuilder::valNumber(double val)
 {
-    m_stack.push(std::make_shared<Literal>(CContent(CValue(val))));
+    m_stack.push(makeNode<Literal>(m_arena, CContent(val)));
 }
 
 void CAstBuilder::valString(std::string val)
 {
-    m_stack.push(std::make_shared<Literal>(CContent(CValue(val))));
+    m_stack.push(makeNode<Literal>(m_arena, m_strings ? m_strings->intern(val) : CContent(std::move(val))));
 }
 
 void CAstBuilder::valNull()
 {
-    m_stack.push(std::make_shared<Literal>(CContent()));
+    m_stack.push(makeNode<Literal>(m_arena, CContent()));
 }
 
 void CAstBuilder::valReference(std::string val)
 {
-    std::shared_ptr<Reference> x = std::make_shared<Reference>(val);
-    m_stack.push(x);
+    m_stack.push(makeNode<Reference>(m_arena, val));
 }
 
 void CAstBuilder::valRange(std::string val)
 {
-    val.size();
+    m_stack.push(makeNode<Range>(m_arena, val));
 }
 
 void CAstBuilder::funcCall(std::string fnName, int paramCount)
 {
-    fnName.size();
-    fnName.append(std::to_string(paramCount));
+    std::optional<CAggregateKind> kind = CAggregator::kindOf(fnName);
+    std::optional<CConditionalKind> conditionalKind = Conditional::kindOf(fnName, paramCount);
+    std::optional<CLookupKind> lookupKind = Lookup::kindOf(fnName, paramCount);
+    if (!kind && !conditionalKind && !lookupKind)
+    {
+        throw std::invalid_argument("unknown function " + fnName);
+    }
+    if (kind && paramCount < 1)
+    {
+        throw std::invalid_argument(std::string("wrong number of arguments of ") + CAggregator::nameOf(*kind));
+    }
+    std::vector<CExprPtr> args(paramCount);
+    for (int i = paramCount - 1; i >= 0; i--)
+    {
+        args[i] = std::move(m_stack.top());
+        m_stack.pop();
+    }
+    if (kind)
+    {
+        m_stack.push(makeNode<Aggregate>(m_arena, *kind, std::move(args)));
+    }
+    else if (conditionalKind)
+    {
+        m_stack.push(makeNode<Conditional>(m_arena, *conditionalKind, std::move(args)));
+    }
+    else
+    {
+        m_stack.push(makeNode<Lookup>(m_arena, *lookupKind, std::move(args)));
+    }
+    foldTop();
+}
+
+void CAstBuilder::foldTop()
+{
+    if (!m_stack.top()->isConstant())
+    {
+        return;
+    }
+    static const CSpreadsheet noSheet; // constant trees never read from the sheet
+    CContent value = m_stack.top()->eval(noSheet, CCellShift());
+
+    // empty value and inf/nan have no literal form, such trees are kept
+    if (value.isMonostate() || (value.isDouble() && !std::isfinite(value.getDouble())))
+    {
+        return;
+    }
+    m_stack.top() = makeNode<Literal>(m_arena, m_strings ? m_strings->intern(value) : value);
+}
+
+CExprPtr CAstBuilder::getResult()
+{
+    CExprPtr result = std::move(m_stack.top());
+    m_stack.pop();
+    return result;
+}
+
+std::shared_ptr<const CFormula> CParseCache::find(std::string_view text)
+{
+    auto found = m_index.find(text);
+    if (found == m_index.end())
+    {
+        return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return found->second->m_formula;
+}
+
+void CParseCache::insert(std::string_view text, std::shared_ptr<const CFormula> formula)
+{
+    if (m_entries.size() == m_capacity)
+    {
+        m_index.erase(m_entries.back().m_text);
+        m_entries.pop_back();
+    }
+    m_entries.push_front(CEntry{std::string(text), std::move(formula)});
+    m_index.emplace(m_entries.front().m_text, m_entries.begin());
+}
+
+size_t CParseCache::size() const
+{
+    return m_index.size();
 }
 
-std::shared_ptr<CExpr> CAstBuilder::getResult() const
+void CParseCache::clear()
 {
-    return m_stack.top();
+    m_index.clear();
+    m_entries.clear();
 }
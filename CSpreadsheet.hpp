@@ -32,10 +32,23 @@
 #include <charconv>
 #include <span>
 #include <utility>
+#include <thread>
+#include <atomic>
+#include <barrier>
 
 #include "expression.h"
+#include "CParser.hpp"
+#include "CAggregator.hpp"
+#include "CColumnTotals.hpp"
+#include "CLookupIndex.hpp"
 #include "CPos.hpp"
+#include "CCellKey.hpp"
 #include "CContent.hpp"
+#include "CProgram.hpp"
+#include "CNodeArena.hpp"
+#include "CTiledTable.hpp"
+#include "CLiteralColumns.hpp"
+#include "CStringPool.hpp"
 
 using namespace std::literals;
 using CValue = std::variant<std::monostate, double, std::string>;
@@ -47,55 +60,151 @@ constexpr unsigned SPREADSHEET_SPEED = 0x08;
 constexpr unsigned SPREADSHEET_PARSER = 0x10;
 
 class CSpreadsheet;
+class CExpr;
+
+// cells read by an expression, a range is kept whole instead of being split into its cells
+// m_cells and m_ranges hold everything the expression may read. Those read only in some branches of a lazy
+// function (see Conditional) are listed again in m_conditionalCells and m_conditionalRanges
+struct CDependencies
+{
+    std::unordered_set<CCellKey, CCellKeyHasher> m_cells;
+    std::vector<CCellRange> m_ranges;
+    std::unordered_set<CCellKey, CCellKeyHasher> m_conditionalCells;
+    std::vector<CCellRange> m_conditionalRanges;
+
+    // set while a lazy function adds the dependencies of its branches
+    bool m_isConditional = false;
+
+    // a cell or range read unconditionally anywhere in the expression isnt conditional
+    void addCell(const CCellKey &pos);
+    void addRange(const CCellRange &range);
+};
+
+// owning pointer to a node, its children are owned the same way, so a tree has a single owner
+using CExprPtr = std::unique_ptr<CExpr, CArenaDeleter<CExpr>>;
 
 // abstract class for a node in the AST
 // all methods are called recursively on its descendants
+// a tree can be shared by several cells, methods taking origin read its relative references moved by origin
+// (see CCell), so a tree parsed from text is read with origin (0, 0). A reference moved outside of the sheet
+// reads nothing: its value is empty, it has no dependencies and it is printed as CParser::OFF_SHEET
 class CExpr
 {
 public:
     virtual ~CExpr() = default;
 
-    virtual void print(std::ostream &os) const = 0;
+    virtual void print(std::ostream &os, const CCellShift &origin) const = 0;
 
     // evaluates the expr tree and all trees that the this tree references
-    virtual CContent eval(const CSpreadsheet &sheet) const = 0;
-    virtual std::shared_ptr<CExpr> clone() const = 0;
+    virtual CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const = 0;
+
+    // appends instructions that compute this tree to program
+    virtual void compile(CProgram &program) const = 0;
+
+    // true if the tree contains no references, so its value doesnt depend on the sheet
+    virtual bool isConstant() const = 0;
+
+    // deep copy with all nodes allocated in arena
+    virtual CExprPtr clone(CNodeArena *arena) const = 0;
 
     // fill dependencies with position of cell that are needed to eval this tree, used in checking for cyclic dependecies
-    virtual void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const = 0;
+    virtual void getDependencies(CDependencies &dependencies, const CCellShift &origin) const = 0;
 
-    // shifts all references by i rows and j col, used for copying
-    void virtual updateRef(int i, int j) = 0;
+    // shifts all references by shift, used to give out a tree that reads the same cells with origin (0, 0)
+    // references shifted outside of the sheet stay off the sheet for good
+    void virtual updateRef(const CCellShift &shift) = 0;
     friend std::ostream &operator<<(std::ostream &os, const CExpr &expr)
     {
-        expr.print(os);
+        expr.print(os, CCellShift());
         return os;
     }
 };
 
+// creates node of type T in arena, or on the heap if arena is nullptr
+template <typename T, typename... Args>
+CExprPtr makeNode(CNodeArena *arena, Args &&...args)
+{
+    if (!arena)
+    {
+        return CExprPtr(new T(std::forward<Args>(args)...), CArenaDeleter<CExpr>{nullptr});
+    }
+    static_assert(sizeof(T) <= CNodeArena::MAX_NODE_SIZE && alignof(T) <= CNodeArena::ALIGNMENT);
+    void *memory = arena->allocate(sizeof(T));
+    try
+    {
+        return CExprPtr(new (memory) T(std::forward<Args>(args)...), CArenaDeleter<CExpr>{arena});
+    }
+    catch (...)
+    {
+        arena->deallocate(memory);
+        throw;
+    }
+}
+
+// reference to a cell, a reference given as CParser::OFF_SHEET is off the sheet whatever origin it is read with
 class Reference : public CExpr
 {
 public:
     Reference(const std::string &pos);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+
+private:
+    CCellKey m_key;
+    bool m_isAbsRow = false;
+    bool m_isAbsCol = false;
+    bool m_isOffSheet = false;
+};
+
+// rectangle of cells like A1:B10, stored as its two corners. Its value alone is empty, functions read its cells
+class Range : public CExpr
+{
+public:
+    Range(const std::string &range);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+
+    // cells of the range read with origin, nullopt if a corner is off the sheet, then the range reads nothing
+    std::optional<CCellRange> at(const CCellShift &origin) const;
+
+    // true if a corner was given as CParser::OFF_SHEET, then the range is off the sheet with any origin
+    bool isOffSheet() const;
+
+    // adds the range to program as read by the aggregate or lookup compiled next, expects !isOffSheet()
+    void compileRange(CProgram &program) const;
 
 private:
-    CPos m_pos;
+    CCellKey m_first;
+    CCellKey m_last;
+    bool m_isAbsFirstRow = false;
+    bool m_isAbsFirstCol = false;
+    bool m_isAbsLastRow = false;
+    bool m_isAbsLastCol = false;
+    bool m_isOffSheet = false;
 };
 
 class Literal : public CExpr
 {
 public:
     Literal(CContent val);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+    const CContent &getValue() const;
 
 private:
     CContent m_value;
@@ -104,16 +213,18 @@ private:
 class Addition : public CExpr
 {
 public:
-    Addition(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
+    Addition(CExprPtr lhs, CExprPtr rhs);
     ~Addition() override = default;
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 
 private:
 };
@@ -121,171 +232,274 @@ private:
 class Multiplication : public CExpr
 {
 public:
-    Multiplication(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Multiplication(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class Division : public CExpr
 {
 public:
-    Division(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Division(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class Subtraction : public CExpr
 {
 public:
-    Subtraction(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Subtraction(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class Exponentiation : public CExpr
 {
 public:
-    Exponentiation(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Exponentiation(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class Negation : public CExpr
 {
 public:
-    Negation(std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Negation(CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Rhs;
 };
 
 class LessThan : public CExpr
 {
 public:
-    LessThan(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    LessThan(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class GreaterThan : public CExpr
 {
 public:
-    GreaterThan(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    GreaterThan(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class Equal : public CExpr
 {
 public:
-    Equal(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    Equal(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class NotEqual : public CExpr
 {
 public:
-    NotEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    NotEqual(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class LessEqual : public CExpr
 {
 public:
-    LessEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    LessEqual(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
 };
 
 class GreaterEqual : public CExpr
 {
 public:
-    GreaterEqual(std::shared_ptr<CExpr> lhs, std::shared_ptr<CExpr> rhs);
-    std::shared_ptr<CExpr> clone() const override;
-    CContent eval(const CSpreadsheet &sheet) const override;
-    void getDependencies(std::unordered_set<CPos, CPosHasher> &dependencies) const override;
-    void updateRef(int i, int j) override;
-    void print(std::ostream &os) const override;
+    GreaterEqual(CExprPtr lhs, CExprPtr rhs);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
 
 private:
-    std::shared_ptr<CExpr> m_Lhs;
-    std::shared_ptr<CExpr> m_Rhs;
+    CExprPtr m_Lhs;
+    CExprPtr m_Rhs;
+};
+
+// call of an aggregate function like SUM(A1:A10, B1, 2). Ranges among its arguments are read by
+// CSpreadsheet::aggregate in blocks, other arguments are evaluated and added as single values
+class Aggregate : public CExpr
+{
+public:
+    Aggregate(CAggregateKind kind, std::vector<CExprPtr> args);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+
+private:
+    CAggregateKind m_kind;
+    std::vector<CExprPtr> m_args;
+};
+
+// functions evaluating only some of their arguments, the others arent read at all
+enum class CConditionalKind : uint8_t
+{
+    IF,      // IF(condition, then[, else]), else is 0 if missing
+    AND,     // 1 if all arguments are non-zero, stops at the first zero
+    OR,      // 1 if any argument is non-zero, stops at the first non-zero
+    CHOOSE,  // CHOOSE(n, first, second, ...) is the n-th of the values after n
+    IFERROR, // IFERROR(value, fallback) is fallback if value is empty, the error value of the sheet
+};
+
+// call of a lazy function, conditions that arent numbers make the result empty. Dependencies of the arguments
+// that are evaluated only in some cases are reported as conditional
+class Conditional : public CExpr
+{
+public:
+    Conditional(CConditionalKind kind, std::vector<CExprPtr> args);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+
+    // returns the function called name (in any case), nullopt if there is none
+    // throws invalid_argument if it cant be called with argCount arguments
+    static std::optional<CConditionalKind> kindOf(std::string_view name, size_t argCount);
+
+private:
+    CConditionalKind m_kind;
+    std::vector<CExprPtr> m_args;
+};
+
+// call of a lookup function like VLOOKUP(A1, B1:D100, 2), one of its arguments is a range (see CLookupKind)
+// the others are evaluated and passed to CSpreadsheet::lookup
+class Lookup : public CExpr
+{
+public:
+    // throws invalid_argument if the argument that has to be a range isnt one
+    Lookup(CLookupKind kind, std::vector<CExprPtr> args);
+    CExprPtr clone(CNodeArena *arena) const override;
+    CContent eval(const CSpreadsheet &sheet, const CCellShift &origin) const override;
+    void compile(CProgram &program) const override;
+    bool isConstant() const override;
+    void getDependencies(CDependencies &dependencies, const CCellShift &origin) const override;
+    void updateRef(const CCellShift &shift) override;
+    void print(std::ostream &os, const CCellShift &origin) const override;
+
+    // returns the function called name (in any case), nullopt if there is none
+    // throws invalid_argument if it cant be called with argCount arguments
+    static std::optional<CLookupKind> kindOf(std::string_view name, size_t argCount);
+
+private:
+    CLookupKind m_kind;
+    std::vector<CExprPtr> m_args;
+
+    // position of the range among m_args
+    size_t rangeArg() const;
 };
 
 class CAstBuilder : public CExprBuilder
 {
 public:
-    CAstBuilder(){};
+    // nodes are allocated in arena, or on the heap if arena is nullptr
+    // string literals are interned in strings, if it isnt nullptr
+    CAstBuilder(CNodeArena *arena = nullptr, CStringPool *strings = nullptr) : m_arena(arena), m_strings(strings){};
     void opAdd() override;
     void opSub() override;
     void opMul() override;
@@ -302,15 +516,75 @@ public:
     void valString(std::string val) override;
     void valNull();
     void valReference(std::string val) override; // TODO
-    void valRange(std::string val) override;     // TODO
+    void valRange(std::string val) override;
+    // builds a call of an aggregate, lazy or lookup function, throws invalid_argument for unknown functions
     void funcCall(std::string fnName,
-                  int paramCount) override; // TODO
+                  int paramCount) override;
+
+    // takes the finished tree out of the builder
+    CExprPtr getResult();
+
+    std::stack<CExprPtr> m_stack;
+
+private:
+    CNodeArena *m_arena;
+    CStringPool *m_strings;
+
+    // replaces the node on top of the stack by a literal with its value, if the node contains no references
+    // and the value can be saved and loaded back
+    void foldTop();
+};
+
+// parsed formula, never changed once built, so all cells filled with the same text or copied from each other
+// share one
+struct CFormula
+{
+    CExprPtr m_expr;
+    CProgram m_program; // m_expr compiled, used for evaluation
+};
+
+// a non-empty cell of the table, its formula is read moved by m_origin: a reference relative in a row or col
+// reads m_origin's rows or cols further. A cell set from text has origin (0, 0), so its formula reads the cells
+// written in it, copyRect moves the origin of the copies instead of changing their formula
+struct CCell
+{
+    std::shared_ptr<const CFormula> m_formula;
+    CCellShift m_origin;
+};
+
+// bounded cache of parsed formulas, maps the text of a formula to the formula built from it and shared with
+// the cells filled with it. Once full, the least recently used formula is dropped
+class CParseCache
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    // keeps at least one formula
+    explicit CParseCache(size_t capacity = DEFAULT_CAPACITY) : m_capacity(std::max<size_t>(capacity, 1)){};
+    CParseCache(const CParseCache &other) = delete;
+    CParseCache &operator=(const CParseCache &other) = delete;
+    CParseCache(CParseCache &&other) = default;
+    CParseCache &operator=(CParseCache &&other) = default;
 
-    std::shared_ptr<CExpr> getResult() const;
+    // returns the formula of text, nullptr if it isnt cached
+    std::shared_ptr<const CFormula> find(std::string_view text);
 
-    std::stack<std::shared_ptr<CExpr>> m_stack;
+    // stores formula of text, expects text not to be cached yet
+    void insert(std::string_view text, std::shared_ptr<const CFormula> formula);
+
+    size_t size() const;
+    void clear();
 
 private:
+    struct CEntry
+    {
+        std::string m_text;
+        std::shared_ptr<const CFormula> m_formula;
+    };
+
+    size_t m_capacity;
+    std::list<CEntry> m_entries;                                               // most recently used first
+    std::unordered_map<std::string_view, std::list<CEntry>::iterator> m_index; // keys point into m_entries
 };
 
 class CSpreadsheet
@@ -318,9 +592,13 @@ class CSpreadsheet
 public:
     static unsigned capabilities()
     {
-        return SPREADSHEET_CYCLIC_DEPS | SPREADSHEET_FILE_IO;
+        return SPREADSHEET_CYCLIC_DEPS | SPREADSHEET_FUNCTIONS | SPREADSHEET_FILE_IO | SPREADSHEET_PARSER;
     }
     CSpreadsheet();
+    CSpreadsheet(const CSpreadsheet &other);
+    CSpreadsheet(CSpreadsheet &&other) = default;
+    CSpreadsheet &operator=(const CSpreadsheet &other);
+    CSpreadsheet &operator=(CSpreadsheet &&other) = default;
     bool load(std::istream &is);
     bool save(std::ostream &os) const;
     bool setCell(CPos pos,
@@ -333,29 +611,203 @@ public:
 
     static constexpr char separator = '|'; // for IO operations
 
-    // returns pointer to the expression stored at pos - doesnt evaluate the cell
-    std::shared_ptr<CExpr> getCell(const CPos &pos) const;
+    // returns a copy of the expression stored at pos - doesnt evaluate the cell
+    // cells holding a plain value are returned as a Literal, empty cells as an empty Literal
+    CExprPtr getCell(const CPos &pos) const;
+
+    // evaluates the cell at pos, the result is memoized until the cell or any cell it depends on changes
+    // expects that pos isnt part of a cycle
+    CContent evalCell(const CCellKey &pos) const;
+
+    // adds values of all cells in range to aggregator, plain numbers are added a block at a time
+    // expects that no cell of range is part of a cycle
+    void aggregate(const CCellRange &range, CAggregator &aggregator) const;
+
+    // evaluates lookup function kind over range, values are its other arguments in order. The values of the
+    // cells of range are indexed by a hash table on first use, kept until one of them changes
+    // expects that no cell of range is part of a cycle
+    CContent lookup(CLookupKind kind, const CCellRange &range, std::span<const CContent> values) const;
+
+    // answers SUM, COUNT and AVG over tall ranges from per column indexes of totals (see CColumnTotals), kept
+    // up to date as cells change. Off by default, sums taken from an index add the same cells in another order,
+    // so they may differ from the sums of the cells one by one by rounding
+    void setColumnIndexes(bool enabled);
+
+    // returns positions of cells that the cell at pos reads by a reference
+    const std::unordered_set<CCellKey, CCellKeyHasher> &getDependencies(const CCellKey &pos) const;
+
+    // returns ranges that the cell at pos reads
+    const std::vector<CCellRange> &getRangeDependencies(const CCellKey &pos) const;
+
+    // returns the part of getDependencies and getRangeDependencies of pos read only in some branches of lazy
+    // functions, in m_conditionalCells and m_conditionalRanges. Cycles and invalidation still follow all of them
+    const CDependencies &getConditionalDependencies(const CCellKey &pos) const;
+
+    // returns positions of cells that read the cell at pos by a reference
+    const std::unordered_set<CCellKey, CCellKeyHasher> &getDependents(const CCellKey &pos) const;
+
+    // finds the cycle status of every cell in the table in one pass, afterwards getValue does no graph traversal
+    // done automatically by load, setCell and copyRect classify the cells they change
+    void classifyCycles() const;
+
+    // evaluates every cell of the table exactly once, each after all cells it reads, and caches the results
+    // with threadCount > 1, cells that dont read each other are evaluated concurrently
+    // returns values of all non-empty cells sorted by position, cells in a cycle have empty value as in getValue
+    std::vector<std::pair<CPos, CValue>> recalculateAll(unsigned threadCount = 1);
 
 private:
-    std::unordered_map<CPos, std::shared_ptr<CExpr>, CPosHasher> m_table;
+    // memory of all expressions in m_table, declared first so it outlives them
+    CNodeArenaPtr m_arena;
+
+    // strings of literals, text cells and cached results, shared with copies of the sheet
+    std::shared_ptr<CStringPool> m_strings;
+
+    // recently parsed formulas, dropped when the arena is compacted
+    CParseCache m_parsed;
+
+    // cells with a formula, cells with a plain number or string are kept only in m_literals
+    CTiledTable<CCell> m_table;
+    CLiteralColumns m_literals;
+
+    // computed values of cells, filled by evalCell
+    mutable std::unordered_map<CCellKey, CContent, CCellKeyHasher> m_cache;
+
+    // indexes of values of formula cells by column, a cell without cached value is unknown in it. Follow
+    // m_cache, an index is dropped when a formula cell is added to or removed from its column
+    bool m_isIndexed = false;
+    mutable std::unordered_map<size_t, CColumnTotals> m_formulaTotals;
+
+    // set while threads evaluate cells, indexes are only read then
+    bool m_isEvaluatingInParallel = false;
 
-    // check if the expression at starts contains a cycle
-    bool isCycle(const CPos &start) const;
+    // indexes of ranges read by lookups, a cell leaving m_cache or changing drops the indexes containing it
+    mutable CLookupCache m_lookups;
+
+    // cycle status of cells, true if the cell is part of a cycle or depends on one, filled by isCycle
+    mutable std::unordered_map<CCellKey, bool, CCellKeyHasher> m_cyclic;
+
+    // dependency graph of m_table in both directions, cells without any edges are not stored
+    std::unordered_map<CCellKey, std::unordered_set<CCellKey, CCellKeyHasher>, CCellKeyHasher> m_dependencies;
+    std::unordered_map<CCellKey, std::unordered_set<CCellKey, CCellKeyHasher>, CCellKeyHasher> m_dependents;
+
+    // ranges read by cells are edges of the graph as a whole. To find readers of a cell, every range is also
+    // listed with its reader under each block of RANGE_BLOCK_COLS columns it overlaps. Ranges over more than
+    // MAX_RANGE_BLOCKS blocks are listed once in m_wideRangeReaders instead, checked for every cell
+    static constexpr size_t RANGE_BLOCK_COLS = 64;
+    static constexpr size_t MAX_RANGE_BLOCKS = 64;
+    std::unordered_map<CCellKey, std::vector<CCellRange>, CCellKeyHasher> m_rangeDependencies;
+    std::unordered_map<size_t, std::vector<std::pair<CCellRange, CCellKey>>> m_rangeReaders;
+    std::vector<std::pair<CCellRange, CCellKey>> m_wideRangeReaders;
+
+    static bool isWideRange(const CCellRange &range)
+    {
+        return range.m_last.getCol() / RANGE_BLOCK_COLS - range.m_first.getCol() / RANGE_BLOCK_COLS >= MAX_RANGE_BLOCKS;
+    }
+
+    // conditional part of the dependencies of cells that have any
+    std::unordered_map<CCellKey, CDependencies, CCellKeyHasher> m_conditionalDependencies;
+
+    // calls f(reader) for every cell that reads pos through one of its ranges, once per such range
+    template <typename F>
+    void forEachRangeReader(const CCellKey &pos, F &&f) const
+    {
+        for (const auto &[range, reader] : m_wideRangeReaders)
+        {
+            if (range.contains(pos))
+            {
+                f(reader);
+            }
+        }
+        auto block = m_rangeReaders.find(pos.getCol() / RANGE_BLOCK_COLS);
+        if (block == m_rangeReaders.end())
+        {
+            return;
+        }
+        for (const auto &[range, reader] : block->second)
+        {
+            if (range.contains(pos))
+            {
+                f(reader);
+            }
+        }
+    }
+
+    // all changes of m_cache go through these, so that m_formulaTotals follow it
+    void cacheValue(const CCellKey &pos, const CContent &value) const;
+    bool uncacheValue(const CCellKey &pos) const;
+    void clearCache();
+
+    // returns the cells of range matching key, indexing range if it isnt yet
+    CLookupIndex::CMatch lookupIn(const CCellRange &range, const CContent &key) const;
+
+    // returns index of formula cells of col, building it if needed. nullptr if there is none while
+    // evaluating in parallel
+    const CColumnTotals *formulaTotalsOf(size_t col) const;
+
+    // returns cells with a formula that the cell at pos reads by a reference or through a range, each once
+    std::vector<CCellKey> formulaDependencies(const CCellKey &pos) const;
+
+    // replaces edges of the cell at pos in the dependency graph by the ones of its current expression
+    void updateDependencies(const CCellKey &pos);
+
+    // stores cell at pos (nullptr empties the cell) and updates dependency graph, cache and cycle statuses
+    // a cell that is just a number or string literal is stored by putLiteral
+    // returns the cells whose cycle status has to be found again
+    std::vector<CCellKey> putCell(const CCellKey &pos, CExprPtr cell);
+    std::vector<CCellKey> putCell(const CCellKey &pos, CCell cell);
+
+    // stores number or string value at pos to m_literals, otherwise same as putCell
+    std::vector<CCellKey> putLiteral(const CCellKey &pos, const CContent &value);
+
+    // moves all expressions to a new arena, once most of the current one is made of freed nodes
+    void compactArena();
+
+    // replaces formulas of all cells by copies with nodes in arena, cells sharing a formula share its copy
+    void cloneFormulas(CNodeArena *arena);
+
+    // drops cached value and cycle status of pos and of all cells that (transitively) depend on it
+    // returns the cells whose cycle status was dropped
+    std::vector<CCellKey> invalidate(const CCellKey &pos);
+
+    // check if the cell at start is part of a cycle or depends on one
+    // the status of every cell visited on the way is cached, so only cells changed since the last call are traversed
+    bool isCycle(const CCellKey &start) const;
+
+    // finds cycle status of starts and of all cells without status they (transitively) read,
+    // using Tarjan's strongly connected components algorithm
+    void classify(const std::vector<CCellKey> &starts) const;
+
+    // splits cells of the table that arent in a cycle into levels, cells of a level read only cells of lower levels
+    // expects all cells to be classified
+    std::vector<std::vector<CCellKey>> evaluationLevels() const;
+
+    // evaluates levels one by one, cells of a level are split among threadCount threads
+    void evalLevelsParallel(const std::vector<std::vector<CCellKey>> &levels, unsigned threadCount);
 
     // creates an expression from input, if it cant -> exception
-    std::shared_ptr<CExpr> setValue(std::string input);
+    CExprPtr setValue(std::string_view input);
+
+    // returns formula of input starting with '=', formulas seen recently are shared from m_parsed instead of
+    // being parsed again. Throws like setValue
+    std::shared_ptr<const CFormula> parseFormula(std::string_view input);
+
+    // stores contents of a cell given as text at pos like putCell, throws before changing anything if input cant be parsed
+    std::vector<CCellKey> putText(const CCellKey &pos, std::string_view input);
+
+    static std::shared_ptr<const CFormula> makeFormula(CExprPtr expr);
 
-    // overwrites cells in rectangle defined by dst, w, h in m_table by cellsToInsert.
-    // If no cell exisits in cellsToInsert to replace it, the target cell is removed from m_table
-    void insertCellsTo(const CPos &dst, const int w, const int h, const std::unordered_map<CPos, std::shared_ptr<CExpr>, CPosHasher> &cellsToInsert);
+    // overwrites cells in rectangle defined by dst, w, h by cellsToInsert and valuesToInsert.
+    // If no cell exisits in them to replace it, the target cell is removed
+    void insertCellsTo(const CCellKey &dst, const int w, const int h, std::vector<std::pair<CCellKey, CCell>> &cellsToInsert,
+                       const std::vector<std::pair<CCellKey, CContent>> &valuesToInsert);
 
     // IO - all methods below return, true on success, false on fail, to read/write
 
     // saves pos to output stream os, in string form ie. row = 1, col = 1 => B1
-    bool savePos(std::ostream &os, const CPos &pos) const;
+    bool savePos(std::ostream &os, const CCellKey &pos) const;
 
     // saves expr to output stream os, the string begins with =
-    bool saveExpr(std::ostream &os, const CExpr &expr) const;
+    bool saveExpr(std::ostream &os, const CExpr &expr, const CCellShift &origin) const;
 
     // first, loads count of char to save to out, then separator, then loads the amount of chars + seperator at end. the separator isnt included in the out string
     bool loadString(std::istream &is, std::string &out) const;
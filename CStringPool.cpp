@@ -0,0 +1,62 @@
+#include "CStringPool.hpp"
+
+CStringPool::~CStringPool()
+{
+    for (auto &entry : m_strings)
+    {
+        // strings that outlive the pool are compared by content again
+        entry.second->m_pool = nullptr;
+        CContent::releaseString(entry.second);
+    }
+}
+
+CContent CStringPool::intern(std::string_view str)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_strings.find(str);
+    if (found != m_strings.end())
+    {
+        return CContent(found->second);
+    }
+    if (m_strings.size() >= m_sweepAt)
+    {
+        sweep();
+    }
+    CContent::CString *string = new CContent::CString{{1}, std::string(str), this}; // the reference of the pool
+    m_strings.insert({string->m_value, string});
+    return CContent(string);
+}
+
+CContent CStringPool::intern(const CContent &value)
+{
+    if (!value.isString() || value.stringData()->m_pool == this)
+    {
+        return value;
+    }
+    return intern(value.getString());
+}
+
+size_t CStringPool::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_strings.size();
+}
+
+void CStringPool::sweep()
+{
+    // a string with a single reference can only be reached through the pool, and m_mutex is locked
+    for (auto it = m_strings.begin(); it != m_strings.end();)
+    {
+        if (it->second->m_refs.load(std::memory_order_acquire) == 1)
+        {
+            CContent::CString *string = it->second;
+            it = m_strings.erase(it);
+            CContent::releaseString(string);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    m_sweepAt = std::max(MIN_SWEEP_SIZE, 2 * m_strings.size());
+}
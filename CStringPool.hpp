@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "CContent.hpp"
+
+// interning table of strings of one spreadsheet (and its copies). Every distinct text has one shared string,
+// so equal strings of the pool are the same object and compare by pointer. The pool keeps a reference to each
+// of its strings and drops the ones nobody else uses once the table doubles in size. Safe to use from
+// several threads
+class CStringPool
+{
+public:
+    CStringPool() = default;
+    CStringPool(const CStringPool &other) = delete;
+    CStringPool &operator=(const CStringPool &other) = delete;
+    ~CStringPool();
+
+    // returns string content with text str, shared with all other contents of the pool with the same text
+    CContent intern(std::string_view str);
+
+    // returns value itself if it isnt a string or already belongs to the pool, otherwise intern(value's text)
+    CContent intern(const CContent &value);
+
+    // count of distinct strings in the pool
+    size_t size() const;
+
+private:
+    static constexpr size_t MIN_SWEEP_SIZE = 1024;
+
+    // frees strings referenced only by the pool, expects m_mutex to be locked
+    void sweep();
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string_view, CContent::CString *> m_strings; // keys point into the strings
+    size_t m_sweepAt = MIN_SWEEP_SIZE;
+};
@@ -0,0 +1,211 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "CCellKey.hpp"
+
+// sparse table of values indexed by cell position. Cells are grouped into tiles of TILE_ROWS x TILE_COLS cells,
+// a tile is allocated when the first of its cells is set and freed with the last one. Populated regions are
+// stored densely and a rectangle is visited with one lookup per tile it overlaps instead of one per cell
+template <typename T>
+class CTiledTable
+{
+public:
+    static constexpr size_t TILE_ROWS = 32;
+    static constexpr size_t TILE_COLS = 8;
+
+    // returns the value of the cell at key, nullptr if the cell isnt set
+    T *find(const CCellKey &key)
+    {
+        auto tile = m_tiles.find(tileOf(key));
+        if (tile == m_tiles.end() || !tile->second->isSet(indexOf(key)))
+        {
+            return nullptr;
+        }
+        return &tile->second->m_cells[indexOf(key)];
+    }
+
+    const T *find(const CCellKey &key) const
+    {
+        return const_cast<CTiledTable *>(this)->find(key);
+    }
+
+    bool contains(const CCellKey &key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    // sets the cell at key to value, the previous value is overwritten
+    T &assign(const CCellKey &key, T value)
+    {
+        std::unique_ptr<CTile> &tile = m_tiles[tileOf(key)];
+        if (!tile)
+        {
+            tile = std::make_unique<CTile>();
+        }
+        size_t index = indexOf(key);
+        if (!tile->isSet(index))
+        {
+            tile->m_set[index / 64] |= uint64_t(1) << (index % 64);
+            tile->m_count++;
+            m_size++;
+        }
+        tile->m_cells[index] = std::move(value);
+        return tile->m_cells[index];
+    }
+
+    // unsets the cell at key, returns false if it wasnt set
+    bool erase(const CCellKey &key)
+    {
+        auto tile = m_tiles.find(tileOf(key));
+        size_t index = indexOf(key);
+        if (tile == m_tiles.end() || !tile->second->isSet(index))
+        {
+            return false;
+        }
+        tile->second->m_set[index / 64] &= ~(uint64_t(1) << (index % 64));
+        tile->second->m_cells[index] = T();
+        m_size--;
+        if (--tile->second->m_count == 0)
+        {
+            m_tiles.erase(tile);
+        }
+        return true;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    void clear()
+    {
+        m_tiles.clear();
+        m_size = 0;
+    }
+
+    // calls f(key, value) for every set cell, tiles are visited in no particular order
+    template <typename F>
+    void forEach(F &&f)
+    {
+        for (auto &tile : m_tiles)
+        {
+            CTile::visit(*tile.second, tile.first, 0, TILE_ROWS, 0, TILE_COLS, f);
+        }
+    }
+
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        const_cast<CTiledTable *>(this)->forEach([&](const CCellKey &key, const T &value)
+                                                 { f(key, value); });
+    }
+
+    // calls f(key, value) for every set cell of the rectangle of h rows and w cols with top left cell corner,
+    // in no particular order, the parts of the rectangle beyond the last addressable row or col are ignored.
+    // Looks up the tiles the rectangle overlaps, or goes through all tiles if there are fewer of them
+    template <typename F>
+    void forEachIn(const CCellKey &corner, size_t w, size_t h, F &&f) const
+    {
+        if (w == 0 || h == 0)
+        {
+            return;
+        }
+        size_t lastRow = std::min<size_t>(corner.getRow() + (h - 1), CCellKey::MAX_INDEX);
+        size_t lastCol = std::min<size_t>(corner.getCol() + (w - 1), CCellKey::MAX_INDEX);
+        size_t tileRows = lastRow / TILE_ROWS - corner.getRow() / TILE_ROWS + 1;
+        size_t tileCols = lastCol / TILE_COLS - corner.getCol() / TILE_COLS + 1;
+        if (tileRows * tileCols > m_tiles.size())
+        {
+            for (const auto &tile : m_tiles)
+            {
+                if (tile.first.getRow() >= corner.getRow() / TILE_ROWS && tile.first.getRow() <= lastRow / TILE_ROWS &&
+                    tile.first.getCol() >= corner.getCol() / TILE_COLS && tile.first.getCol() <= lastCol / TILE_COLS)
+                {
+                    visitPart(tile.first, *tile.second, corner, lastRow, lastCol, f);
+                }
+            }
+            return;
+        }
+        for (size_t tileRow = corner.getRow() / TILE_ROWS; tileRow <= lastRow / TILE_ROWS; tileRow++)
+        {
+            for (size_t tileCol = corner.getCol() / TILE_COLS; tileCol <= lastCol / TILE_COLS; tileCol++)
+            {
+                auto tile = m_tiles.find(CCellKey(tileRow, tileCol));
+                if (tile != m_tiles.end())
+                {
+                    visitPart(tile->first, *tile->second, corner, lastRow, lastCol, f);
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t TILE_SIZE = TILE_ROWS * TILE_COLS;
+    static_assert(64 % TILE_COLS == 0 && TILE_SIZE % 64 == 0);
+
+    // cells of a tile are stored row by row, m_set has a bit for every cell that is set
+    struct CTile
+    {
+        std::array<T, TILE_SIZE> m_cells;
+        std::array<uint64_t, TILE_SIZE / 64> m_set = {};
+        size_t m_count = 0;
+
+        bool isSet(size_t index) const
+        {
+            return (m_set[index / 64] >> (index % 64)) & 1;
+        }
+
+        // calls f for set cells with row in [rowBegin, rowEnd) and col in [colBegin, colEnd) of the tile
+        template <typename Self, typename F>
+        static void visit(Self &tile, const CCellKey &tileKey, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd, F &f)
+        {
+            uint64_t colMask = ((uint64_t(1) << (colEnd - colBegin)) - 1) << colBegin;
+            for (size_t row = rowBegin; row < rowEnd; row++)
+            {
+                // all cols of a row lie in one word of m_set
+                size_t first = row * TILE_COLS;
+                uint64_t bits = (tile.m_set[first / 64] >> (first % 64)) & colMask;
+                while (bits)
+                {
+                    size_t col = std::countr_zero(bits);
+                    bits &= bits - 1;
+                    f(CCellKey(tileKey.getRow() * TILE_ROWS + row, tileKey.getCol() * TILE_COLS + col), tile.m_cells[first + col]);
+                }
+            }
+        }
+    };
+
+    // visits cells of the tile inside the rectangle from corner to (lastRow, lastCol)
+    template <typename F>
+    static void visitPart(const CCellKey &tileKey, const CTile &tile, const CCellKey &corner, size_t lastRow, size_t lastCol, F &f)
+    {
+        size_t firstRow = tileKey.getRow() * TILE_ROWS;
+        size_t firstCol = tileKey.getCol() * TILE_COLS;
+        // bounds of the rectangle inside the tile, end exclusive
+        size_t rowBegin = std::max(corner.getRow(), firstRow) - firstRow;
+        size_t rowEnd = std::min(lastRow, firstRow + TILE_ROWS - 1) - firstRow + 1;
+        size_t colBegin = std::max(corner.getCol(), firstCol) - firstCol;
+        size_t colEnd = std::min(lastCol, firstCol + TILE_COLS - 1) - firstCol + 1;
+        CTile::visit(tile, tileKey, rowBegin, rowEnd, colBegin, colEnd, f);
+    }
+
+    static CCellKey tileOf(const CCellKey &key)
+    {
+        return CCellKey(key.getRow() / TILE_ROWS, key.getCol() / TILE_COLS);
+    }
+
+    static size_t indexOf(const CCellKey &key)
+    {
+        return (key.getRow() % TILE_ROWS) * TILE_COLS + key.getCol() % TILE_COLS;
+    }
+
+    std::unordered_map<CCellKey, std::unique_ptr<CTile>, CCellKeyHasher> m_tiles;
+    size_t m_size = 0;
+};
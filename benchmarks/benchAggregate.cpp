@@ -0,0 +1,57 @@
+// compares SUM over a column of a million numbers against reading the same cells one by one
+// -march=native turns on the AVX2 loop of CAggregator::addNumbers where the machine has it, drop it to time
+// the scalar loop that the default make build uses
+// build: g++ -std=c++20 -O2 -march=native -pthread -I. benchmarks/benchAggregate.cpp $(ls *.cpp | grep -v main.cpp) -o benchAggregate
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <chrono>
+
+template <typename F>
+double measureMillis(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    constexpr int rows = 1000000;
+    constexpr int rounds = 20;
+    CSpreadsheet sheet;
+    double expected = 0;
+    for (int row = 1; row <= rows; row++)
+    {
+        sheet.setCell(CPos(row, 0), std::to_string(row % 1000));
+        expected += row % 1000;
+    }
+    sheet.setCell(CPos("B1"), "=SUM(A1:A" + std::to_string(rows) + ")");
+
+    // the leaf is changed every round so the sum is computed again
+    double total = 0;
+    double perCell = measureMillis([&]
+                                   {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos(1, 0), std::to_string(r));
+            for (int row = 1; row <= rows; row++)
+            {
+                total += std::get<double>(sheet.getValue(CPos(row, 0)));
+            }
+        } });
+    double aggregate = measureMillis([&]
+                                     {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos(1, 0), std::to_string(r));
+            total -= std::get<double>(sheet.getValue(CPos("B1")));
+        } });
+    assert(total == 0);
+    assert(std::get<double>(sheet.getValue(CPos("B1"))) == expected - 1 + (rounds - 1));
+
+    std::cout << rows << " numbers x " << rounds << " rounds" << std::endl;
+    std::cout << "getValue per cell: " << perCell / rounds << " ms/sum" << std::endl;
+    std::cout << "SUM(range):        " << aggregate / rounds << " ms/sum, "
+              << rows * sizeof(double) / (aggregate / rounds) / 1e6 << " GB/s" << std::endl;
+    return EXIT_SUCCESS;
+}
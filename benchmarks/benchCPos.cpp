@@ -0,0 +1,119 @@
+// compares CPos parsing and printing against the previous stream based implementation
+// build: g++ -std=c++20 -O2 -I. benchmarks/benchCPos.cpp CPos.cpp -o benchCPos
+#include "CPos.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// the implementation replaced by the single pass parser, kept here as the baseline
+struct CStreamPos
+{
+    size_t m_row = 0;
+    size_t m_col = 0;
+    bool m_isAbsRow = false;
+    bool m_isAbsCol = false;
+
+    CStreamPos(std::string_view str)
+    {
+        std::istringstream input{std::string(str)};
+        if (input.peek() == '$')
+        {
+            m_isAbsCol = true;
+            input.get();
+        }
+        char ch;
+        std::vector<size_t> digits;
+        while (std::isalpha(ch = input.peek()))
+        {
+            digits.push_back((std::tolower(ch) - 'a') + 1);
+            input.get();
+        }
+        if (!(std::isdigit(ch) || ch == '$') || digits.empty())
+        {
+            throw std::invalid_argument("unknown char in COL");
+        }
+        size_t result = 0;
+        for (size_t i = 0; i < digits.size(); i++)
+        {
+            result += digits.at(i) * pow(26, i);
+        }
+        m_col = result - 1;
+        if (input.peek() == '$')
+        {
+            m_isAbsRow = true;
+            input.get();
+        }
+        input >> m_row;
+        if (!input.eof())
+        {
+            throw std::invalid_argument("unknown char in ROW");
+        }
+    }
+
+    std::string getCol() const
+    {
+        std::string result;
+        size_t num = m_col + 1;
+        while (num > 0)
+        {
+            result += char(num % 26 + 'A' - 1);
+            num /= 26;
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    void print(std::ostream &os) const
+    {
+        if (m_isAbsCol)
+            os << "$";
+        os << getCol();
+        if (m_isAbsRow)
+            os << "$";
+        os << m_row;
+    }
+};
+
+template <typename F>
+double measure(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    std::vector<std::string> inputs;
+    for (size_t i = 0; i < 200000; i++)
+    {
+        std::ostringstream oss;
+        oss << CPos(i % 5000, i % 1000, i % 3 == 0, i % 5 == 0);
+        inputs.push_back(oss.str());
+    }
+
+    constexpr int rounds = 10;
+    size_t checksum = 0;
+    double oldParse = measure([&]
+                              { for (int r = 0; r < rounds; r++) for (const auto &s : inputs) checksum += CStreamPos(s).m_row; });
+    double newParse = measure([&]
+                              { for (int r = 0; r < rounds; r++) for (const auto &s : inputs) checksum -= CPos(s).m_row; });
+    assert(checksum == 0);
+
+    std::ostringstream sink;
+    double oldPrint = measure([&]
+                              { for (int r = 0; r < rounds; r++) for (size_t i = 0; i < inputs.size(); i++) CStreamPos(inputs[i]).print(sink); });
+    sink.str("");
+    double newPrint = measure([&]
+                              { for (int r = 0; r < rounds; r++) for (size_t i = 0; i < inputs.size(); i++) CPos(inputs[i]).print(sink); });
+
+    size_t count = rounds * inputs.size();
+    std::cout << "parse:          stream " << oldParse * 1e6 / count << " ns/pos, single pass " << newParse * 1e6 / count
+              << " ns/pos, speedup " << oldParse / newParse << "x" << std::endl;
+    std::cout << "parse + print:  stream " << oldPrint * 1e6 / count << " ns/pos, single pass " << newPrint * 1e6 / count
+              << " ns/pos, speedup " << oldPrint / newPrint << "x" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+// compares many overlapping SUMs over one column with and without column indexes
+// build: g++ -std=c++20 -O2 -march=native -pthread -I. benchmarks/benchColumnTotals.cpp $(ls *.cpp | grep -v main.cpp) -o benchColumnTotals
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <chrono>
+
+template <typename F>
+double measureMillis(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a column of numbers and a column of running totals, the leaf is changed every round so all totals change
+double measure(bool isIndexed, int rows, int sums, int rounds, double &last)
+{
+    CSpreadsheet sheet;
+    sheet.setColumnIndexes(isIndexed);
+    for (int row = 1; row <= rows; row++)
+    {
+        sheet.setCell(CPos(row, 0), std::to_string(row % 100));
+    }
+    int step = rows / sums;
+    for (int i = 1; i <= sums; i++)
+    {
+        sheet.setCell(CPos(i, 1), "=SUM(A1:A" + std::to_string(i * step) + ")");
+    }
+    return measureMillis([&]
+                         {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos(1, 0), std::to_string(r));
+            last = 0;
+            for (int i = 1; i <= sums; i++)
+            {
+                last += std::get<double>(sheet.getValue(CPos(i, 1)));
+            }
+        } });
+}
+
+int main()
+{
+    constexpr int rows = 200000;
+    constexpr int sums = 1000;
+    constexpr int rounds = 10;
+    double scanned = 0;
+    double indexed = 0;
+    double scanMillis = measure(false, rows, sums, rounds, scanned);
+    double indexMillis = measure(true, rows, sums, rounds, indexed);
+    assert(scanned == indexed);
+
+    std::cout << sums << " running totals over " << rows << " numbers x " << rounds << " rounds" << std::endl;
+    std::cout << "scan:    " << scanMillis / rounds << " ms/round" << std::endl;
+    std::cout << "indexed: " << indexMillis / rounds << " ms/round" << std::endl;
+    return EXIT_SUCCESS;
+}
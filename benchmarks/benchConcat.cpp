@@ -0,0 +1,105 @@
+// counts allocations of long string concatenations, copying operands against extending the result in place
+// build: g++ -std=c++20 -O2 -pthread -I. benchmarks/benchConcat.cpp $(ls *.cpp | grep -v main.cpp) -o benchConcat
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct CResult
+{
+    size_t m_allocations;
+    double m_millis;
+};
+
+template <typename F>
+CResult measure(F &&f)
+{
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    f();
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {allocations - before, millis};
+}
+
+int main()
+{
+    constexpr int terms = 500;
+    constexpr int rounds = 200;
+    const CContent word(std::string("spreadsheet"));
+
+    // folding (((a + a) + a) + ...) the way the evaluator does, each step either copies the whole prefix or appends to it
+    size_t length = 0;
+    CResult copying = measure([&]
+                              {
+        for (int r = 0; r < rounds; r++)
+        {
+            CContent acc = word;
+            for (int i = 1; i < terms; i++)
+            {
+                acc = std::as_const(acc) + word;
+            }
+            length += acc.getString().size();
+        } });
+    CResult inPlace = measure([&]
+                              {
+        for (int r = 0; r < rounds; r++)
+        {
+            CContent acc = word;
+            for (int i = 1; i < terms; i++)
+            {
+                acc = std::move(acc) + word;
+            }
+            length -= acc.getString().size();
+        } });
+    assert(length == 0);
+
+    // the same chain as a formula, the leaf is changed every round so the formula is evaluated again
+    CSpreadsheet sheet;
+    std::string formula = "=A1";
+    for (int i = 1; i < terms; i++)
+    {
+        formula += "+A1";
+    }
+    sheet.setCell(CPos("B1"), formula);
+    CResult sheetEval = measure([&]
+                                {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos("A1"), r % 2 ? "spreadsheet" : "SPREADSHEET");
+            length += std::get<std::string>(sheet.getValue(CPos("B1"))).size();
+        } });
+    assert(length == size_t(rounds) * terms * word.getString().size());
+
+    std::cout << terms << " terms x " << rounds << " rounds" << std::endl;
+    std::cout << "copying operands:   " << double(copying.m_allocations) / rounds << " allocations/formula, "
+              << copying.m_millis / rounds << " ms/formula" << std::endl;
+    std::cout << "appending in place: " << double(inPlace.m_allocations) / rounds << " allocations/formula, "
+              << inPlace.m_millis / rounds << " ms/formula" << std::endl;
+    std::cout << "sheet (set + eval): " << double(sheetEval.m_allocations) / rounds << " allocations/formula, "
+              << sheetEval.m_millis / rounds << " ms/formula" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+// compares guarded formulas whose untaken branch sums a large range: IF against the same choice made by arithmetic
+// build: g++ -std=c++20 -O2 -march=native -pthread -I. benchmarks/benchConditional.cpp $(ls *.cpp | grep -v main.cpp) -o benchConditional
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <chrono>
+
+template <typename F>
+double measureMillis(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// guards are off, so every formula is just the value of A1, the guard is changed every round so all formulas change
+double measure(const std::string &formula, int rows, int formulas, int rounds, double &last)
+{
+    CSpreadsheet sheet;
+    for (int row = 1; row <= rows; row++)
+    {
+        sheet.setCell(CPos(row, 0), std::to_string(row % 100));
+    }
+    for (int i = 1; i <= formulas; i++)
+    {
+        sheet.setCell(CPos(i, 1), formula);
+    }
+    return measureMillis([&]
+                         {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos("C1"), r % 2 ? "-0" : "0");
+            last = 0;
+            for (int i = 1; i <= formulas; i++)
+            {
+                last += std::get<double>(sheet.getValue(CPos(i, 1)));
+            }
+        } });
+}
+
+int main()
+{
+    constexpr int rows = 100000;
+    constexpr int formulas = 200;
+    constexpr int rounds = 10;
+    std::string range = "$A$1:$A$" + std::to_string(rows);
+    double eager = 0;
+    double lazy = 0;
+    double eagerMillis = measure("=$C$1 * SUM(" + range + ") + (1 - $C$1) * A1", rows, formulas, rounds, eager);
+    double lazyMillis = measure("=IF($C$1, SUM(" + range + "), A1)", rows, formulas, rounds, lazy);
+    assert(eager == lazy);
+
+    std::cout << formulas << " guarded sums over " << rows << " numbers x " << rounds << " rounds" << std::endl;
+    std::cout << "arithmetic: " << eagerMillis / rounds << " ms/round" << std::endl;
+    std::cout << "IF:         " << lazyMillis / rounds << " ms/round" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+// compares exact VLOOKUPs against one key column with finding the key by reading the column cell by cell
+// build: g++ -std=c++20 -O2 -march=native -pthread -I. benchmarks/benchLookup.cpp $(ls *.cpp | grep -v main.cpp) -o benchLookup
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <chrono>
+
+template <typename F>
+double measureMillis(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    constexpr int rows = 20000;
+    constexpr int lookups = 2000;
+    constexpr int rounds = 10;
+    constexpr int scans = 20;
+    CSpreadsheet sheet;
+    for (int row = 1; row <= rows; row++)
+    {
+        sheet.setCell(CPos(row, 0), "key" + std::to_string(row));
+        sheet.setCell(CPos(row, 1), std::to_string(row * 2));
+    }
+    std::string range = "$A$1:$B$" + std::to_string(rows);
+    for (int i = 1; i <= lookups; i++)
+    {
+        int key = i * (rows / lookups);
+        sheet.setCell(CPos(i, 3), "=VLOOKUP(\"key" + std::to_string(key) + "\", " + range + ", 2)");
+    }
+
+    // a key of the range is changed every round, so its index is built again and every lookup evaluated
+    double total = 0;
+    double indexed = measureMillis([&]
+                                   {
+        for (int r = 0; r < rounds; r++)
+        {
+            sheet.setCell(CPos(1, 0), "first" + std::to_string(r));
+            for (int i = 1; i <= lookups; i++)
+            {
+                total += std::get<double>(sheet.getValue(CPos(i, 3)));
+            }
+        } });
+    double scanned = measureMillis([&]
+                                   {
+        for (int i = 1; i <= scans; i++)
+        {
+            std::string key = "key" + std::to_string(i * (rows / scans));
+            for (int row = 1; row <= rows; row++)
+            {
+                if (std::get<std::string>(sheet.getValue(CPos(row, 0))) == key)
+                {
+                    total -= std::get<double>(sheet.getValue(CPos(row, 1)));
+                    break;
+                }
+            }
+        } });
+    assert(total > 0);
+
+    std::cout << lookups << " lookups in " << rows << " rows x " << rounds << " rounds" << std::endl;
+    std::cout << "VLOOKUP:       " << indexed / rounds << " ms/round, " << indexed * 1000 / rounds / lookups << " us/lookup" << std::endl;
+    std::cout << "cell by cell:  " << scanned * 1000 / scans << " us/lookup" << std::endl;
+    return EXIT_SUCCESS;
+}
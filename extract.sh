@@ -1,3 +1,3 @@
 #!/bin/bash
 #ignores all includes, pragma, and constexpr unsigned for symbolic constants in CSpreadsheet.hpp, which are already defined on progtest
-grep -vEh '^(#include|#pragma|constexpr unsigned)' CPos.hpp CPos.cpp CContent.hpp CContent.cpp CSpreadsheet.hpp CSpreadsheet.cpp > submission/all_in_one.cpp
\ No newline at end of file
+grep -vEh '^(#include|#pragma|constexpr unsigned)' CPos.hpp CPos.cpp CCellKey.hpp CCellKey.cpp CTiledTable.hpp CContent.hpp CContent.cpp CStringPool.hpp CStringPool.cpp CAggregator.hpp CAggregator.cpp CColumnTotals.hpp CColumnTotals.cpp CLookupIndex.hpp CLookupIndex.cpp CLiteralColumns.hpp CLiteralColumns.cpp CNodeArena.hpp CNodeArena.cpp CParser.hpp CParser.cpp CProgram.hpp CSpreadsheet.hpp CProgram.cpp CSpreadsheet.cpp > submission/all_in_one.cpp
\ No newline at end of file
@@ -173,6 +173,634 @@ int main()
     assert(valueMatch(x0.getValue(CPos("H12")), CValue(25.0)));
     assert(valueMatch(x0.getValue(CPos("H13")), CValue(-22.0)));
     assert(valueMatch(x0.getValue(CPos("H14")), CValue(-22.0)));
+
+    // TESTS OF VALUE CACHE
+    // every cell reads the previous one twice, without memoization the last cell would take 2^60 evaluations
+    CSpreadsheet x2;
+    assert(x2.setCell(CPos("A1"), "1"));
+    for (int i = 2; i <= 60; i++)
+    {
+        std::string prev = "A" + std::to_string(i - 1);
+        assert(x2.setCell(CPos("A" + std::to_string(i)), "=" + prev + "+" + prev));
+    }
+    assert(valueMatch(x2.getValue(CPos("A60")), CValue(std::pow(2.0, 59))));
+    assert(x2.setCell(CPos("A30"), "0"));
+    assert(valueMatch(x2.getValue(CPos("A29")), CValue(std::pow(2.0, 28))));
+    assert(valueMatch(x2.getValue(CPos("A60")), CValue(0.0)));
+    x2.copyRect(CPos("A30"), CPos("A29"));
+    assert(valueMatch(x2.getValue(CPos("A60")), CValue(std::pow(2.0, 59))));
+
+    // TESTS OF DEPENDENCY INDEX
+    assert(x2.getDependencies(CCellKey(CPos("A30"))).size() == 1 && x2.getDependencies(CCellKey(CPos("A30"))).contains(CCellKey(CPos("A29"))));
+    assert(x2.getDependents(CCellKey(CPos("A29"))).size() == 1 && x2.getDependents(CCellKey(CPos("A29"))).contains(CCellKey(CPos("A30"))));
+    assert(x2.setCell(CPos("B1"), "=A29*$A$29"));
+    assert(x2.getDependents(CCellKey(CPos("A29"))).size() == 2);
+    x2.copyRect(CPos("B2"), CPos("B1"));
+    assert(x2.getDependents(CCellKey(CPos("A29"))).size() == 3 && x2.getDependents(CCellKey(CPos("A30"))).size() == 2);
+    assert(x2.setCell(CPos("B1"), "5"));
+    assert(x2.getDependencies(CCellKey(CPos("B1"))).empty());
+    assert(x2.getDependents(CCellKey(CPos("A29"))).size() == 2 && x2.getDependents(CCellKey(CPos("A29"))).contains(CCellKey(CPos("B2"))));
+    assert(x2.getDependents(CCellKey(CPos("C7"))).empty());
+
+    // TESTS OF CYCLIC DEPENDENCIES
+    CSpreadsheet x3;
+    assert(x3.setCell(CPos("A1"), "=B1+1"));
+    assert(x3.setCell(CPos("B1"), "=C1*2"));
+    assert(x3.setCell(CPos("D1"), "=A1"));
+    assert(valueMatch(x3.getValue(CPos("D1")), CValue()));
+    assert(x3.setCell(CPos("C1"), "=A1"));
+    assert(valueMatch(x3.getValue(CPos("A1")), CValue()));
+    assert(valueMatch(x3.getValue(CPos("C1")), CValue()));
+    assert(valueMatch(x3.getValue(CPos("D1")), CValue()));
+    assert(x3.setCell(CPos("E1"), "=E1"));
+    assert(valueMatch(x3.getValue(CPos("E1")), CValue()));
+    assert(x3.setCell(CPos("C1"), "3"));
+    assert(valueMatch(x3.getValue(CPos("A1")), CValue(7.0)));
+    assert(valueMatch(x3.getValue(CPos("D1")), CValue(7.0)));
+    x3.copyRect(CPos("C1"), CPos("A1"));
+    assert(valueMatch(x3.getValue(CPos("D1")), CValue()));
+    assert(x3.setCell(CPos("F1"), "0"));
+    x3.copyRect(CPos("C1"), CPos("F1"));
+    assert(valueMatch(x3.getValue(CPos("D1")), CValue(1.0)));
+    assert(x3.setCell(CPos("G1"), "=H1"));
+    assert(x3.setCell(CPos("H1"), "=G1+D1"));
+    oss.clear();
+    oss.str("");
+    assert(x3.save(oss));
+    iss.clear();
+    iss.str(oss.str());
+    assert(x1.load(iss));
+    assert(valueMatch(x1.getValue(CPos("D1")), CValue(1.0)));
+    assert(valueMatch(x1.getValue(CPos("E1")), CValue()));
+    assert(valueMatch(x1.getValue(CPos("G1")), CValue()));
+    assert(valueMatch(x1.getValue(CPos("H1")), CValue()));
+    x1.classifyCycles();
+    assert(valueMatch(x1.getValue(CPos("A1")), CValue(1.0)));
+
+    // TESTS OF FULL RECALCULATION
+    std::vector<std::pair<CPos, CValue>> values = x1.recalculateAll();
+    assert(values.size() == 8);
+    assert(values[0].first == CPos("A1") && valueMatch(values[0].second, CValue(1.0)));
+    assert(values[1].first == CPos("B1") && valueMatch(values[1].second, CValue(0.0)));
+    assert(values[3].first == CPos("D1") && valueMatch(values[3].second, CValue(1.0)));
+    assert(values[4].first == CPos("E1") && valueMatch(values[4].second, CValue()));
+    assert(values[6].first == CPos("G1") && valueMatch(values[6].second, CValue()));
+    assert(x1.setCell(CPos("F1"), "2"));
+    x1.copyRect(CPos("C1"), CPos("F1"));
+    assert(valueMatch(x1.getValue(CPos("D1")), CValue(5.0)));
+    assert(valueMatch(x2.recalculateAll().back().second, CValue(std::pow(2.0, 59))));
+
+    // TESTS OF PARALLEL RECALCULATION
+    CSpreadsheet x4;
+    for (int i = 0; i < 50; i++)
+    {
+        for (char col = 'A'; col <= 'J'; col++)
+        {
+            std::string pos = col + std::to_string(i);
+            std::string above = col + std::to_string(i - 1);
+            assert(x4.setCell(CPos(pos), i == 0 ? std::to_string(col - 'A') : "=" + above + "*2+" + above));
+        }
+    }
+    assert(x4.setCell(CPos("K49"), "=K49"));
+    std::vector<std::pair<CPos, CValue>> serial = x4.recalculateAll();
+    std::vector<std::pair<CPos, CValue>> parallel = x4.recalculateAll(4);
+    assert(serial.size() == 501 && serial.size() == parallel.size());
+    for (size_t i = 0; i < serial.size(); i++)
+    {
+        assert(serial[i].first == parallel[i].first && valueMatch(serial[i].second, parallel[i].second));
+    }
+    assert(valueMatch(x4.getValue(CPos("C3")), CValue(54.0)));
+    assert(valueMatch(x4.getValue(CPos("K49")), CValue()));
+
+    // TESTS OF CONSTANT FOLDING
+    CSpreadsheet x5;
+    assert(x5.setCell(CPos("A0"), "=(1+2*3 ^ 2 ) / (2 < 3) "));
+    assert(x5.setCell(CPos("A1"), "=A0 + 2 * -3"));
+    assert(x5.setCell(CPos("A2"), "=1 / 3 + A1 * (2 - 2 ^ -1)"));
+    assert(x5.setCell(CPos("A3"), "=\"ab\" + \"\"\"c\" + A2 * (\"x\" < 2)"));
+    assert(x5.setCell(CPos("A4"), "=2 ^ 2000 + A1"));
+    oss.clear();
+    oss.str("");
+    oss << *x5.getCell(CPos("A0")) << "|" << *x5.getCell(CPos("A1")) << "|" << *x5.getCell(CPos("A2")) << "|" << *x5.getCell(CPos("A3"));
+    assert(oss.str() == "19|(A0+(-6))|(0.3333333333333333+(A1*1.5))|(\"ab\"\"c\"+(A2*(\"x\"<2)))");
+    assert(valueMatch(x5.getValue(CPos("A2")), CValue(1.0 / 3 + 19.5)));
+    assert(valueMatch(x5.getValue(CPos("A3")), CValue()));
+    assert(valueMatch(x5.getValue(CPos("A4")), CValue(std::pow(2.0, 2000))));
+    oss.clear();
+    oss.str("");
+    assert(x5.save(oss));
+    iss.clear();
+    iss.str(oss.str());
+    assert(x1.load(iss));
+    assert(std::get<double>(x1.getValue(CPos("A2"))) == 1.0 / 3 + 19.5);
+    assert(valueMatch(x1.getValue(CPos("A4")), CValue(std::pow(2.0, 2000))));
+
+    // TESTS OF NODE ARENA
+    {
+        CSpreadsheet x6;
+        for (int i = 0; i < 5000; i++)
+        {
+            std::string formula = "=A1+B1*" + std::to_string(i) + "+C" + std::to_string(i % 7) + "-\"" + std::string(i % 50, 'x') + "\"";
+            assert(x6.setCell(CPos("D" + std::to_string(i % 10)), formula));
+        }
+        assert(x6.setCell(CPos("A1"), "1"));
+        assert(x6.setCell(CPos("B1"), "2"));
+        assert(x6.setCell(CPos("C5"), "=A1*10"));
+        assert(valueMatch(x6.getValue(CPos("D9")), CValue()));
+        assert(x6.setCell(CPos("D9"), "=A1+B1*4999+C5"));
+        assert(valueMatch(x6.getValue(CPos("D9")), CValue(10009.0)));
+        x5 = x6;
+    }
+    assert(valueMatch(x5.getValue(CPos("D9")), CValue(10009.0)));
+    oss.clear();
+    oss.str("");
+    oss << *x5.getCell(CPos("D9")) << "|" << *x5.getCell(CPos("Z99"));
+    assert(oss.str() == "((A1+(B1*4999))+C5)|std::monostate");
+
+    // TESTS OF TILED TABLE
+    // block spanning several tiles, copied onto an overlapping rectangle
+    CSpreadsheet x7;
+    for (int i = 0; i < 40; i++)
+    {
+        for (char col = 'A'; col <= 'L'; col++)
+        {
+            std::string formula = i == 0 ? "1" : "=" + std::string(1, col) + std::to_string(i - 1) + "+1";
+            assert(x7.setCell(CPos(col + std::to_string(i)), formula));
+        }
+    }
+    assert(x7.setCell(CPos("Z100"), "=F44"));
+    x7.copyRect(CPos("F5"), CPos("A0"), 12, 40);
+    assert(valueMatch(x7.getValue(CPos("A39")), CValue(40.0)));
+    assert(valueMatch(x7.getValue(CPos("F5")), CValue(1.0)));
+    assert(valueMatch(x7.getValue(CPos("Q44")), CValue(40.0)));
+    assert(valueMatch(x7.getValue(CPos("E4")), CValue(5.0)));
+    assert(valueMatch(x7.getValue(CPos("Z100")), CValue(40.0)));
+    x7.copyRect(CPos("F5"), CPos("AA1000"), 12, 40);
+    assert(valueMatch(x7.getValue(CPos("Q44")), CValue()));
+    assert(valueMatch(x7.getValue(CPos("E4")), CValue(5.0)));
+    assert(valueMatch(x7.getValue(CPos("Z100")), CValue()));
+    assert(x7.recalculateAll().size() == 12 * 5 + 5 * 35 + 1);
+
+    // TESTS OF STRING INTERNING
+    CSpreadsheet x8;
+    assert(x8.setCell(CPos("A1"), "fruit"));
+    assert(x8.setCell(CPos("A2"), "=\"fru\" + \"it\""));
+    assert(x8.setCell(CPos("A3"), "=A1 + \"\""));
+    assert(x8.setCell(CPos("B1"), "=(A1 = A2) + (A1 = A3) + (A2 <> A3) + (A1 = \"fruits\")"));
+    assert(valueMatch(x8.getValue(CPos("B1")), CValue(2.0)));
+    x5 = x8;
+    assert(x5.setCell(CPos("A1"), "fruits"));
+    assert(valueMatch(x5.getValue(CPos("B1")), CValue(3.0)));
+    assert(valueMatch(x8.getValue(CPos("B1")), CValue(2.0)));
+
+    // TESTS OF SHARED FORMULAS
+    // running total filled down by copying doubling blocks, all cells of the column share one formula
+    CSpreadsheet x9;
+    assert(x9.setCell(CPos("A0"), "2"));
+    assert(x9.setCell(CPos("B0"), "0"));
+    assert(x9.setCell(CPos("B1"), "=B0 + $A$0 + A$0"));
+    for (int rows = 1; rows < 10000; rows *= 2)
+    {
+        x9.copyRect(CPos(1 + rows, 1), CPos("B1"), 1, rows);
+    }
+    x9.recalculateAll(); // level by level, the chain is too deep to evaluate recursively
+    assert(valueMatch(x9.getValue(CPos("B16384")), CValue(16384 * 4.0)));
+    oss.clear();
+    oss.str("");
+    oss << *x9.getCell(CPos("B7000"));
+    assert(oss.str() == "((B6999+$A$0)+A$0)");
+    x9.copyRect(CPos("D100"), CPos("B7000"));
+    oss.clear();
+    oss.str("");
+    assert(x9.save(oss));
+    assert(oss.str().find("4|D100|17|=((D99+$A$0)+C$0)|") != std::string::npos);
+    iss.clear();
+    iss.str(oss.str());
+    assert(x1.load(iss));
+    assert(x1.setCell(CPos("A0"), "1"));
+    x1.recalculateAll();
+    assert(valueMatch(x1.getValue(CPos("B16384")), CValue(16384 * 2.0)));
+    assert(valueMatch(x1.getValue(CPos("D100")), CValue()));
+
+    // TESTS OF RANGES
+    CSpreadsheet x10;
+    assert(x10.setCell(CPos("A1"), "=B$2:$C5"));
+    assert(x10.setCell(CPos("A2"), "=A1:A1000000000 = A1000000001:$A$1"));
+    assert(!x10.setCell(CPos("A3"), "=A1:"));
+    oss.clear();
+    oss.str("");
+    oss << *x10.getCell(CPos("A1")) << "|" << *x10.getCell(CPos("A2"));
+    assert(oss.str() == "B$2:$C5|(A1:A1000000000=A1000000001:$A$1)");
+    assert(valueMatch(x10.getValue(CPos("A1")), CValue()));
+    // each range is one edge, the reader is found from any cell of it
+    assert(x10.getDependencies(CCellKey(CPos("A2"))).empty() && x10.getRangeDependencies(CCellKey(CPos("A2"))).size() == 2);
+    assert(x10.getRangeDependencies(CCellKey(CPos("A1")))[0] == CCellRange(CCellKey(CPos("B2")), CCellKey(CPos("C5"))));
+    x10.copyRect(CPos("B7"), CPos("A1"));
+    oss.clear();
+    oss.str("");
+    oss << *x10.getCell(CPos("B7"));
+    assert(oss.str() == "C$2:$C11");
+    assert(x10.getRangeDependencies(CCellKey(CPos("B7")))[0] == CCellRange(CCellKey(CPos("C2")), CCellKey(CPos("C11"))));
+    assert(x10.setCell(CPos("A1"), "1"));
+    assert(x10.getRangeDependencies(CCellKey(CPos("A1"))).empty());
+    assert(x10.recalculateAll().size() == 3);
+
+    // TESTS OF FUNCTIONS
+    CSpreadsheet x11;
+    for (int row = 1; row <= 100; row++)
+    {
+        assert(x11.setCell(CPos("A" + std::to_string(row)), std::to_string(row)));
+    }
+    assert(x11.setCell(CPos("A50"), "fifty"));
+    assert(x11.setCell(CPos("A60"), "=A59 + 1"));
+    assert(x11.setCell(CPos("B1"), "=SUM(A1:A100)"));
+    assert(x11.setCell(CPos("B2"), "=count(A1:A100)"));
+    assert(x11.setCell(CPos("B3"), "=Min(A1:A100, -3)"));
+    assert(x11.setCell(CPos("B4"), "=MAX(A100:A1)"));
+    assert(x11.setCell(CPos("B5"), "=AVG(A1:A3, A50)"));
+    assert(x11.setCell(CPos("B6"), "=SUM(C1:C10) + COUNT(C1:C10)"));
+    assert(x11.setCell(CPos("B7"), "=SUM(1, 2, \"x\") + COUNT(B100)"));
+    assert(x11.setCell(CPos("B8"), "=SUM(A1:A1000000000, $B$1)"));
+    assert(!x11.setCell(CPos("B9"), "=SQRT(A1)"));
+    for (const char *call : {"=SUM()", "=min()", "=MAX()", "=COUNT()", "=AVG()", "=1 + SUM(A1, COUNT())"})
+    {
+        assert(!x11.setCell(CPos("B9"), call));
+    }
+    assert(valueMatch(x11.getValue(CPos("B1")), CValue(5000.0)));
+    assert(valueMatch(x11.getValue(CPos("B2")), CValue(100.0)));
+    assert(valueMatch(x11.getValue(CPos("B3")), CValue(-3.0)));
+    assert(valueMatch(x11.getValue(CPos("B4")), CValue(100.0)));
+    assert(valueMatch(x11.getValue(CPos("B5")), CValue(2.0)));
+    assert(valueMatch(x11.getValue(CPos("B6")), CValue()));
+    assert(valueMatch(x11.getValue(CPos("B7")), CValue(3.0)));
+    assert(valueMatch(x11.getValue(CPos("B8")), CValue(10000.0)));
+    oss.clear();
+    oss.str("");
+    oss << *x11.getCell(CPos("B3")) << "|" << *x11.getCell(CPos("B7"));
+    assert(oss.str() == "MIN(A1:A100, (-3))|(3+COUNT(B100))");
+    // changes of plain values and of formulas in the range reach the readers
+    assert(x11.setCell(CPos("A59"), "159"));
+    assert(x11.setCell(CPos("A1"), "-1"));
+    assert(valueMatch(x11.getValue(CPos("B1")), CValue(5198.0)));
+    assert(valueMatch(x11.getValue(CPos("B3")), CValue(-3.0)));
+    assert(valueMatch(x11.getValue(CPos("B4")), CValue(160.0)));
+    assert(valueMatch(x11.getValue(CPos("B5")), CValue(4.0 / 3)));
+    // a cell in a cycle makes every range over it cyclic too
+    x11.copyRect(CPos("C1"), CPos("B1"));
+    assert(x11.setCell(CPos("B50"), "=SUM(B49:B51)"));
+    assert(valueMatch(x11.getValue(CPos("B50")), CValue()));
+    assert(valueMatch(x11.getValue(CPos("C1")), CValue()));
+    assert(valueMatch(x11.getValue(CPos("B8")), CValue(10396.0)));
+    oss.clear();
+    oss.str("");
+    assert(x11.save(oss));
+    CSpreadsheet x12;
+    iss.clear();
+    iss.str(oss.str());
+    assert(x12.load(iss));
+    assert(valueMatch(x12.getValue(CPos("B1")), CValue(5198.0)));
+    assert(valueMatch(x12.getValue(CPos("B5")), CValue(4.0 / 3)));
+    assert(x12.recalculateAll(4) == x11.recalculateAll());
+
+    // TESTS OF COLUMN INDEXES
+    // the same sheet with and without indexes, every change has to give the same values
+    CSpreadsheet x13;
+    CSpreadsheet x14;
+    x13.setColumnIndexes(true);
+    auto setBoth = [&](const std::string &pos, const std::string &contents)
+    {
+        assert(x13.setCell(CPos(pos), contents) && x14.setCell(CPos(pos), contents));
+    };
+    auto checkBoth = [&]()
+    {
+        for (int row = 0; row < 60; row++)
+        {
+            assert(valueMatch(x13.getValue(CPos(row, 3)), x14.getValue(CPos(row, 3))));
+        }
+    };
+    for (int row = 0; row < 2000; row++)
+    {
+        std::string pos = std::to_string(row);
+        setBoth("A" + pos, row % 17 ? std::to_string(row % 13) : "text");
+        if (row % 3 == 0)
+        {
+            setBoth("B" + pos, "=A" + pos + " * 2");
+        }
+    }
+    setBoth("D0", "=SUM(A0:B1999)");
+    setBoth("D1", "=COUNT(A0:B1999)");
+    setBoth("D2", "=AVG(B0:B1999) * 3");
+    setBoth("D3", "=MAX(A0:B1999)");
+    setBoth("D4", "=SUM(A10:A310)");
+    for (int row = 5; row < 60; row++)
+    {
+        x13.copyRect(CPos(row, 3), CPos("D4"));
+        x14.copyRect(CPos(row, 3), CPos("D4"));
+    }
+    checkBoth();
+    // formulas multiplying "text" (every 51st row) have no value and arent counted
+    assert(valueMatch(x13.getValue(CPos("D1")), CValue(2000.0 + 667 - 40)));
+    setBoth("A100", "1000");
+    setBoth("B99", "=A99 * 3");
+    setBoth("B300", "=-A300");
+    setBoth("A5", "=5");
+    checkBoth();
+    setBoth("B99", "");
+    setBoth("B150", "=A150 + A151");
+    x13.copyRect(CPos("B1000"), CPos("B0"), 1, 500);
+    x14.copyRect(CPos("B1000"), CPos("B0"), 1, 500);
+    checkBoth();
+    assert(x13.recalculateAll(4) == x14.recalculateAll());
+    setBoth("A200", "-7");
+    checkBoth();
+
+    // TESTS OF LAZY FUNCTIONS
+    CSpreadsheet x15;
+    assert(x15.setCell(CPos("A1"), "1"));
+    assert(x15.setCell(CPos("A2"), "=A1 * 10"));
+    assert(x15.setCell(CPos("A3"), "text"));
+    assert(x15.setCell(CPos("B1"), "=IF(A1 > 0, SUM(C1:C1000000), A2)"));
+    assert(x15.setCell(CPos("B2"), "=if(A1, A2)"));
+    assert(x15.setCell(CPos("B3"), "=AND(A1, A2 > 5) + OR(0, A1 = 2) * 2"));
+    assert(x15.setCell(CPos("B4"), "=CHOOSE(A1 + 1, A2, A3, B1)"));
+    assert(x15.setCell(CPos("B5"), "=IFERROR(1 / (A1 - 1), \"div\")"));
+    assert(x15.setCell(CPos("B6"), "=IF(A3, 1, 2)"));
+    assert(!x15.setCell(CPos("B7"), "=IF(A1)"));
+    assert(!x15.setCell(CPos("B7"), "=IFERROR(A1, A2, A3)"));
+    assert(valueMatch(x15.getValue(CPos("B1")), CValue()));
+    assert(valueMatch(x15.getValue(CPos("B2")), CValue(10.0)));
+    assert(valueMatch(x15.getValue(CPos("B3")), CValue(1.0)));
+    assert(valueMatch(x15.getValue(CPos("B4")), CValue("text")));
+    assert(valueMatch(x15.getValue(CPos("B5")), CValue("div")));
+    assert(valueMatch(x15.getValue(CPos("B6")), CValue()));
+    oss.clear();
+    oss.str("");
+    oss << *x15.getCell(CPos("B1")) << "|" << *x15.getCell(CPos("B4"));
+    assert(oss.str() == "IF((A1>0), SUM(C1:C1000000), A2)|CHOOSE((A1+1), A2, A3, B1)");
+    // only the condition is read whatever it is, a cell read in both ways is read unconditionally
+    const CDependencies &conditional = x15.getConditionalDependencies(CCellKey(CPos("B1")));
+    assert(conditional.m_conditionalCells.size() == 1 && conditional.m_conditionalCells.contains(CCellKey(CPos("A2"))));
+    assert(conditional.m_conditionalRanges.size() == 1 && x15.getRangeDependencies(CCellKey(CPos("B1"))).size() == 1);
+    assert(x15.getDependencies(CCellKey(CPos("B1"))).size() == 2);
+    assert(x15.getConditionalDependencies(CCellKey(CPos("B3"))).m_conditionalCells.size() == 1);
+    assert(x15.setCell(CPos("B8"), "=IF(A1, A2, 0) + A2"));
+    assert(x15.getConditionalDependencies(CCellKey(CPos("B8"))).m_conditionalCells.empty());
+    assert(x15.getConditionalDependencies(CCellKey(CPos("A2"))).m_conditionalCells.empty());
+    assert(x15.setCell(CPos("A1"), "0"));
+    assert(valueMatch(x15.getValue(CPos("B1")), CValue(0.0)));
+    assert(valueMatch(x15.getValue(CPos("B2")), CValue(0.0)));
+    assert(valueMatch(x15.getValue(CPos("B3")), CValue(0.0)));
+    assert(valueMatch(x15.getValue(CPos("B4")), CValue(0.0)));
+    assert(valueMatch(x15.getValue(CPos("B5")), CValue(-1.0)));
+    assert(x15.setCell(CPos("C5"), "7"));
+    assert(x15.setCell(CPos("A1"), "2"));
+    assert(valueMatch(x15.getValue(CPos("B1")), CValue(7.0)));
+    assert(valueMatch(x15.getValue(CPos("B3")), CValue(3.0)));
+    assert(valueMatch(x15.getValue(CPos("B4")), CValue(7.0)));
+    // cycles are found from all dependencies, even ones in a branch that isnt taken
+    assert(x15.setCell(CPos("C1"), "=IF(0, B1, 1)"));
+    assert(valueMatch(x15.getValue(CPos("B1")), CValue()) && valueMatch(x15.getValue(CPos("C1")), CValue()));
+    assert(x15.setCell(CPos("C1"), "=IFERROR(A3 * 2, 1)"));
+    assert(valueMatch(x15.getValue(CPos("B1")), CValue(8.0)));
+    oss.clear();
+    oss.str("");
+    assert(x15.save(oss));
+    iss.clear();
+    iss.str(oss.str());
+    CSpreadsheet x16;
+    assert(x16.load(iss));
+    assert(x16.recalculateAll(4) == x15.recalculateAll());
+    assert(x16.getConditionalDependencies(CCellKey(CPos("B1"))).m_conditionalRanges.size() == 1);
+
+    // TESTS OF LOOKUPS
+    CSpreadsheet x17;
+    for (int row = 1; row <= 100; row++)
+    {
+        std::string pos = std::to_string(row);
+        assert(x17.setCell(CPos("A" + pos), "key" + pos));
+        assert(x17.setCell(CPos("B" + pos), std::to_string(row * 10)));
+        assert(x17.setCell(CPos("C" + pos), "=B" + pos + " + 1"));
+    }
+    assert(x17.setCell(CPos("D1"), "=VLOOKUP(\"key42\", A1:C100, 2)"));
+    assert(x17.setCell(CPos("D2"), "=vlookup(\"key42\", $A$1:$C$100, 3, 0)"));
+    assert(x17.setCell(CPos("D3"), "=MATCH(\"key42\", A1:A100)"));
+    assert(x17.setCell(CPos("D4"), "=COUNTIF(C1:C100, 421) + COUNTIF(A1:C100, 420) * 10"));
+    assert(x17.setCell(CPos("D5"), "=VLOOKUP(\"nope\", A1:C100, 2)"));
+    assert(x17.setCell(CPos("D6"), "=VLOOKUP(\"key1\", A1:C100, 4)"));
+    assert(x17.setCell(CPos("D7"), "=MATCH(10, A1:B2)"));
+    assert(x17.setCell(CPos("D8"), "=VLOOKUP(\"key1\", A1:C100, 2, 1)"));
+    assert(x17.setCell(CPos("D9"), "=MATCH(421, C1:C100, 0) + MATCH(VLOOKUP(\"key3\", A1:B100, 2), B1:B100)"));
+    assert(!x17.setCell(CPos("D10"), "=VLOOKUP(1, A1, 2)"));
+    assert(!x17.setCell(CPos("D10"), "=COUNTIF(1, A1:A3)"));
+    assert(!x17.setCell(CPos("D10"), "=MATCH(1)"));
+    assert(valueMatch(x17.getValue(CPos("D1")), CValue(420.0)));
+    assert(valueMatch(x17.getValue(CPos("D2")), CValue(421.0)));
+    assert(valueMatch(x17.getValue(CPos("D3")), CValue(42.0)));
+    assert(valueMatch(x17.getValue(CPos("D4")), CValue(11.0)));
+    assert(valueMatch(x17.getValue(CPos("D5")), CValue()));
+    assert(valueMatch(x17.getValue(CPos("D6")), CValue()));
+    assert(valueMatch(x17.getValue(CPos("D7")), CValue()));
+    assert(valueMatch(x17.getValue(CPos("D8")), CValue()));
+    assert(valueMatch(x17.getValue(CPos("D9")), CValue(45.0)));
+    oss.clear();
+    oss.str("");
+    oss << *x17.getCell(CPos("D2")) << "|" << *x17.getCell(CPos("D4"));
+    assert(oss.str() == "VLOOKUP(\"key42\", $A$1:$C$100, 3, 0)|(COUNTIF(C1:C100, 421)+(COUNTIF(A1:C100, 420)*10))");
+    // indexes are dropped once a cell of their range changes, directly or through the cells it reads
+    assert(x17.setCell(CPos("A42"), "other"));
+    assert(valueMatch(x17.getValue(CPos("D1")), CValue()));
+    assert(x17.setCell(CPos("A50"), "key42"));
+    assert(valueMatch(x17.getValue(CPos("D1")), CValue(500.0)));
+    assert(valueMatch(x17.getValue(CPos("D2")), CValue(501.0)));
+    assert(x17.setCell(CPos("E1"), "key"));
+    assert(x17.setCell(CPos("A30"), "=E1 + \"42\""));
+    assert(valueMatch(x17.getValue(CPos("D3")), CValue(30.0)));
+    assert(x17.setCell(CPos("E1"), "yek"));
+    assert(valueMatch(x17.getValue(CPos("D3")), CValue(50.0)));
+    assert(x17.setCell(CPos("B42"), "0"));
+    assert(valueMatch(x17.getValue(CPos("D4")), CValue(0.0)));
+    assert(x17.setCell(CPos("B7"), "420"));
+    assert(valueMatch(x17.getValue(CPos("D4")), CValue(11.0)));
+    x17.copyRect(CPos("A50"), CPos("A51"));
+    assert(valueMatch(x17.getValue(CPos("D2")), CValue()));
+    oss.clear();
+    oss.str("");
+    assert(x17.save(oss));
+    iss.clear();
+    iss.str(oss.str());
+    CSpreadsheet x18;
+    assert(x18.load(iss));
+    assert(x18.recalculateAll(4) == x17.recalculateAll());
+    assert(x18.setCell(CPos("A100"), "key42"));
+    assert(valueMatch(x18.getValue(CPos("D1")), CValue(1000.0)));
+
+    // TESTS OF REFERENCES COPIED OFF THE SHEET
+    CSpreadsheet x19;
+    assert(x19.setCell(CPos("A0"), "7"));
+    assert(x19.setCell(CPos("A1"), "5"));
+    assert(x19.setCell(CPos("B0"), "3"));
+    assert(x19.setCell(CPos("B1"), "1"));
+    assert(x19.setCell(CPos("B2"), "=A1+10"));
+    assert(x19.setCell(CPos("E2"), "=E0+10"));
+    assert(x19.setCell(CPos("C3"), "=$A1+A$1+$A$1+A$0"));
+    x19.copyRect(CPos("A2"), CPos("B2"));
+    x19.copyRect(CPos("E1"), CPos("E2"));
+    x19.copyRect(CPos("D2"), CPos("C3"));
+    x19.copyRect(CPos("A3"), CPos("C3"));
+    assert(valueMatch(x19.getValue(CPos("A2")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("E1")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("D2")), CValue(16.0)));
+    assert(valueMatch(x19.getValue(CPos("A3")), CValue()));
+    oss.clear();
+    oss.str("");
+    oss << *x19.getCell(CPos("A2")) << "|" << *x19.getCell(CPos("E1")) << "|" << *x19.getCell(CPos("D2")) << "|" << *x19.getCell(CPos("A3"));
+    assert(oss.str() == "(#REF!+10)|(#REF!+10)|((($A0+B$1)+$A$1)+B$0)|((($A1+#REF!)+$A$1)+#REF!)");
+    // a reference once off the sheet stays there when copied back
+    x19.copyRect(CPos("B2"), CPos("A2"));
+    assert(valueMatch(x19.getValue(CPos("B2")), CValue()));
+    x19.copyRect(CPos("C3"), CPos("A3"));
+    oss.clear();
+    oss.str("");
+    oss << *x19.getCell(CPos("B2")) << "|" << *x19.getCell(CPos("C3"));
+    assert(oss.str() == "(#REF!+10)|((($A1+#REF!)+$A$1)+#REF!)");
+    assert(x19.setCell(CPos("A0"), "1"));
+    assert(valueMatch(x19.getValue(CPos("D2")), CValue(10.0)));
+    // ranges copied toward row 0 and col A
+    assert(x19.setCell(CPos("C2"), "1"));
+    assert(x19.setCell(CPos("C5"), "=SUM(B1:C2)"));
+    assert(x19.setCell(CPos("D5"), "=COUNTIF(B1:C2, 1)"));
+    assert(x19.setCell(CPos("E5"), "=SUM($B$1:C2)"));
+    x19.copyRect(CPos("A5"), CPos("C5"), 3, 1);
+    x19.copyRect(CPos("C0"), CPos("C5"), 3, 1);
+    assert(valueMatch(x19.getValue(CPos("A5")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("B5")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("C5")), CValue(6.0)));
+    assert(valueMatch(x19.getValue(CPos("C0")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("D0")), CValue()));
+    assert(valueMatch(x19.getValue(CPos("E0")), CValue()));
+    oss.clear();
+    oss.str("");
+    oss << *x19.getCell(CPos("A5")) << "|" << *x19.getCell(CPos("B5")) << "|" << *x19.getCell(CPos("C5"));
+    assert(oss.str() == "SUM(#REF!:#REF!)|COUNTIF(#REF!:#REF!, 1)|SUM($B$1:A2)");
+    assert(x19.getDependencies(CCellKey(CPos("A5"))).empty());
+    oss.clear();
+    oss.str("");
+    assert(x19.save(oss));
+    iss.clear();
+    iss.str(oss.str());
+    CSpreadsheet x20;
+    assert(x20.load(iss));
+    assert(x20.recalculateAll(4) == x19.recalculateAll());
+    oss.clear();
+    oss.str("");
+    oss << *x20.getCell(CPos("A3")) << "|" << *x20.getCell(CPos("D0"));
+    assert(oss.str() == "((($A1+#REF!)+$A$1)+#REF!)|COUNTIF(#REF!:#REF!, 1)");
+
+    // TESTS OF WIDE RANGES
+    CSpreadsheet x21;
+    assert(x21.setCell(CPos("A0"), "0"));
+    assert(x21.setCell(CPos("A1"), "1"));
+    assert(x21.setCell(CPos("B2"), "2"));
+    assert(x21.setCell(CPos("ZZZZZZ2"), "2"));
+    assert(x21.setCell(CPos("B5"), "=SUM(A1:ZZZZZZ2)"));
+    assert(x21.setCell(CPos("C5"), "=SUM(A1:A2) + SUM(B1:B2) + SUM(A0:B0)"));
+    x21.copyRect(CPos("B6"), CPos("B5"));
+    assert(valueMatch(x21.getValue(CPos("B5")), CValue(5.0)));
+    assert(valueMatch(x21.getValue(CPos("B6")), CValue(4.0)));
+    assert(valueMatch(x21.getValue(CPos("C5")), CValue(3.0)));
+    assert(x21.setCell(CPos("XYZ1"), "10"));
+    assert(x21.setCell(CPos("B0"), "10"));
+    assert(valueMatch(x21.getValue(CPos("B5")), CValue(15.0)));
+    assert(valueMatch(x21.getValue(CPos("B6")), CValue(4.0)));
+    assert(valueMatch(x21.getValue(CPos("C5")), CValue(13.0)));
+    // readers listed under several ranges are dropped from all of them
+    assert(x21.setCell(CPos("C5"), "5"));
+    assert(x21.setCell(CPos("B5"), "=ZZZZZZ2"));
+    assert(x21.setCell(CPos("XYZ2"), "20"));
+    assert(valueMatch(x21.getValue(CPos("B6")), CValue(24.0)));
+    assert(x21.getRangeDependencies(CCellKey(CPos("B5"))).empty() && x21.getRangeDependencies(CCellKey(CPos("C5"))).empty());
+    // copies of ranges toward row 0 and col A read nothing and leave the graph as it was
+    assert(x21.setCell(CPos("C5"), "=SUM(B1:C2)"));
+    assert(x21.setCell(CPos("D5"), "=COUNTIF(B1:C2, 1) + SUM(C$0:C2)"));
+    x21.copyRect(CPos("A5"), CPos("C5"), 2, 1);
+    x21.copyRect(CPos("C1"), CPos("C5"), 2, 1);
+    assert(valueMatch(x21.getValue(CPos("A5")), CValue()));
+    assert(valueMatch(x21.getValue(CPos("B5")), CValue()));
+    assert(valueMatch(x21.getValue(CPos("C1")), CValue()));
+    assert(valueMatch(x21.getValue(CPos("D1")), CValue()));
+    assert(x21.getRangeDependencies(CCellKey(CPos("A5"))).empty() && x21.getRangeDependencies(CCellKey(CPos("D1"))).empty());
+    CSpreadsheet x22(x21);
+    assert(x22.setCell(CPos("ZZZZZZ2"), "4"));
+    assert(valueMatch(x22.getValue(CPos("B6")), CValue(26.0)));
+    assert(valueMatch(x21.getValue(CPos("B6")), CValue(24.0)));
+
+    // TESTS OF LOOKUPS OVER COPIED RANGES
+    CSpreadsheet x23;
+    assert(x23.setCell(CPos("B1"), "1"));
+    assert(x23.setCell(CPos("C2"), "1"));
+    assert(x23.setCell(CPos("C1"), "key"));
+    assert(x23.setCell(CPos("D1"), "10"));
+    assert(x23.setCell(CPos("D2"), "20"));
+    assert(x23.setCell(CPos("ZZZZZZ1"), "1"));
+    assert(x23.setCell(CPos("E5"), "=COUNTIF(B1:C2, 1)"));
+    assert(x23.setCell(CPos("F5"), "=VLOOKUP(\"key\", C1:D2, 2)"));
+    assert(x23.setCell(CPos("G5"), "=MATCH(1, B1:D1, 0)"));
+    assert(x23.setCell(CPos("H5"), "=COUNTIF(A1:ZZZZZZ2, 1)"));
+    x23.copyRect(CPos("E6"), CPos("E5"), 4, 1);
+    x23.copyRect(CPos("A5"), CPos("E5"), 4, 1);
+    x23.copyRect(CPos("E0"), CPos("E5"), 4, 1);
+    assert(valueMatch(x23.getValue(CPos("E5")), CValue(2.0)));
+    assert(valueMatch(x23.getValue(CPos("F5")), CValue(10.0)));
+    assert(valueMatch(x23.getValue(CPos("G5")), CValue(1.0)));
+    assert(valueMatch(x23.getValue(CPos("H5")), CValue(3.0)));
+    assert(valueMatch(x23.getValue(CPos("E6")), CValue(1.0)));
+    assert(valueMatch(x23.getValue(CPos("F6")), CValue()));
+    assert(valueMatch(x23.getValue(CPos("G6")), CValue(2.0)));
+    assert(valueMatch(x23.getValue(CPos("H6")), CValue(1.0)));
+    for (const char *pos : {"A5", "B5", "C5", "D5", "E0", "F0", "G0", "H0"})
+    {
+        assert(valueMatch(x23.getValue(CPos(pos)), CValue()));
+    }
+    oss.clear();
+    oss.str("");
+    oss << *x23.getCell(CPos("B5")) << "|" << *x23.getCell(CPos("C5")) << "|" << *x23.getCell(CPos("D5"));
+    assert(oss.str() == "VLOOKUP(\"key\", #REF!:#REF!, 2)|MATCH(1, #REF!:#REF!, 0)|COUNTIF(#REF!:#REF!, 1)");
+    // indexes of the copied ranges follow their cells
+    assert(x23.setCell(CPos("C3"), "1"));
+    assert(x23.setCell(CPos("XYZ3"), "1"));
+    assert(x23.setCell(CPos("D1"), "11"));
+    assert(valueMatch(x23.getValue(CPos("E6")), CValue(2.0)));
+    assert(valueMatch(x23.getValue(CPos("H6")), CValue(3.0)));
+    assert(valueMatch(x23.getValue(CPos("F5")), CValue(11.0)));
+    assert(valueMatch(x23.getValue(CPos("H5")), CValue(3.0)));
+
+    // TESTS OF COLUMN INDEXES WITH EXTREME VALUES
+    // values outside of a range dont change its sum, however big they are
+    CSpreadsheet x24;
+    x24.setColumnIndexes(true);
+    assert(x24.setCell(CPos("A0"), "1e20"));
+    for (int row = 64; row < 1000; row++)
+    {
+        assert(x24.setCell(CPos(row, 0), "1"));
+        assert(x24.setCell(CPos(row, 1), "=A" + std::to_string(row)));
+    }
+    assert(x24.setCell(CPos("D0"), "=SUM(A64:A999)"));
+    assert(x24.setCell(CPos("D1"), "=SUM(B1:B999)"));
+    assert(valueMatch(x24.getValue(CPos("D0")), CValue(936.0)));
+    assert(x24.setCell(CPos("A0"), "1e308"));
+    assert(x24.setCell(CPos("A1"), "1e308"));
+    assert(valueMatch(x24.getValue(CPos("D0")), CValue(936.0)));
+    assert(valueMatch(x24.getValue(CPos("D1")), CValue(936.0)));
+    assert(x24.setCell(CPos("C0"), "1e308"));
+    assert(x24.setCell(CPos("B0"), "=C0 * 10"));
+    assert(x24.setCell(CPos("C1"), "1"));
+    assert(x24.setCell(CPos("B1"), "=C1"));
+    assert(valueMatch(x24.getValue(CPos("D1")), CValue(937.0)));
+    assert(x24.setCell(CPos("C1"), "2"));
+    assert(valueMatch(x24.getValue(CPos("D1")), CValue(938.0)));
+    assert(x24.setCell(CPos("C0"), "-1e308"));
+    assert(x24.setCell(CPos("C1"), "3"));
+    assert(valueMatch(x24.getValue(CPos("D1")), CValue(939.0)));
     return EXIT_SUCCESS;
 }
 #endif /* __PROGTEST__ */
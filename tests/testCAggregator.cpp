@@ -0,0 +1,66 @@
+#include "CAggregator.hpp"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+int main()
+{
+    assert(CAggregator::kindOf("sum") == CAggregateKind::SUM && CAggregator::kindOf("Avg") == CAggregateKind::AVG);
+    assert(!CAggregator::kindOf("SUMX") && !CAggregator::kindOf(""));
+    assert(std::string(CAggregator::nameOf(CAggregateKind::COUNT)) == "COUNT");
+
+    // nothing added
+    assert(CAggregator(CAggregateKind::SUM).result().isMonostate() && CAggregator(CAggregateKind::MIN).result().isMonostate());
+    assert(CAggregator(CAggregateKind::COUNT).result().getDouble() == 0);
+    assert(CAggregator(CAggregateKind::AVG).isAdditive() && !CAggregator(CAggregateKind::MAX).isAdditive());
+
+    // a block with every third number set, the rest is garbage that must be skipped
+    std::vector<double> block(CAggregator::BLOCK_SIZE);
+    uint64_t mask = 0;
+    double sum = 0;
+    for (size_t i = 0; i < CAggregator::BLOCK_SIZE; i++)
+    {
+        if (i % 3 == 0)
+        {
+            block[i] = double(i) - 30;
+            mask |= uint64_t(1) << i;
+            sum += block[i];
+        }
+        else
+        {
+            block[i] = i % 2 ? 1e300 : -1e300;
+        }
+    }
+    auto aggregate = [&](CAggregateKind kind)
+    {
+        CAggregator aggregator(kind);
+        aggregator.add(CContent(CValue(0.5)));
+        aggregator.add(CContent(CValue("text")));
+        aggregator.add(CContent());
+        aggregator.addNumbers(block.data(), mask);
+        aggregator.addNumbers(block.data(), 0);
+        aggregator.addStrings(2);
+        return aggregator.result();
+    };
+    assert(aggregate(CAggregateKind::SUM).getDouble() == sum + 0.5);
+    assert(aggregate(CAggregateKind::MIN).getDouble() == -30);
+    assert(aggregate(CAggregateKind::MAX).getDouble() == 33);
+    assert(aggregate(CAggregateKind::COUNT).getDouble() == 22 + 1 + 1 + 2);
+    assert(aggregate(CAggregateKind::AVG).getDouble() == (sum + 0.5) / 23);
+
+    // totals count as the values they summarize
+    CAggregator totals(CAggregateKind::AVG);
+    totals.addTotals(CTotals::of(CContent(CValue(3.0))));
+    totals.addTotals(CTotals::of(CContent(CValue(5.0))));
+    totals.add(CContent(CValue(7.0)));
+    assert(totals.result().getDouble() == 5);
+
+    // the last bit of the mask and a block with a single number
+    CAggregator lowest(CAggregateKind::MIN);
+    CAggregator highest(CAggregateKind::MAX);
+    lowest.addNumbers(block.data(), uint64_t(1) << 63);
+    highest.addNumbers(block.data(), uint64_t(1) << 63);
+    assert(lowest.result().getDouble() == 33 && highest.result().getDouble() == 33);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
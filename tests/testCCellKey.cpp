@@ -0,0 +1,55 @@
+#include "CCellKey.hpp"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+int main()
+{
+    CCellKey a(CPos("B7"));
+    assert(a.getRow() == 7 && a.getCol() == 1);
+    assert(CCellKey(CPos("$B$7")) == a);
+    assert(CCellKey(3, 4) < CCellKey(3, 5) && CCellKey(3, 5) < CCellKey(4, 0));
+    assert(a.shiftedBy(2, -1) == CCellKey(9, 0));
+    assert(CCellKey(CCellKey::MAX_INDEX, CCellKey::MAX_INDEX).getRow() == CCellKey::MAX_INDEX);
+
+    // relative parts move by the origin, positions moved outside of the sheet are nullopt
+    assert(a.resolvedAt(CCellShift{-7, -1}, false, false) == CCellKey(0, 0));
+    assert(a.resolvedAt(CCellShift{-8, 0}, false, false) == std::nullopt);
+    assert(a.resolvedAt(CCellShift{-8, -2}, true, true) == a);
+    assert(a.resolvedAt(CCellShift{-8, 3}, true, false) == CCellKey(7, 4));
+    assert(a.resolvedAt(CCellShift{0, -2}, true, false) == std::nullopt);
+    assert(CCellKey(0, CCellKey::MAX_INDEX).resolvedAt(CCellShift{}.shiftedBy(0, 1), false, false) == std::nullopt);
+
+    CCellRange range(CCellKey(5, 1), CCellKey(2, 3)); // corners in any order
+    assert(range.m_first == CCellKey(2, 1) && range.m_last == CCellKey(5, 3));
+    assert(range.getWidth() == 3 && range.getHeight() == 4);
+    assert(range.contains(CCellKey(3, 2)) && range.contains(CCellKey(5, 1)) && !range.contains(CCellKey(6, 2)) && !range.contains(CCellKey(3, 0)));
+
+    std::ostringstream oss;
+    oss << a.toPos(true, false) << "|" << a.toPos();
+    assert(oss.str() == "B$7|B7");
+
+    try
+    {
+        CCellKey((size_t)CCellKey::MAX_INDEX + 1, 0);
+        assert(false);
+    }
+    catch (const std::invalid_argument &e)
+    {
+    }
+
+    // a square block of cells must not share buckets
+    CCellKeyHasher hasher;
+    std::unordered_set<size_t> hashes;
+    for (size_t i = 0; i < 256; i++)
+    {
+        for (size_t j = 0; j < 256; j++)
+        {
+            hashes.insert(hasher(CCellKey(i, j)) % 65521);
+        }
+    }
+    assert(hashes.size() > 40000);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include "CColumnTotals.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+CTotals number(double value)
+{
+    return CTotals::of(CContent(CValue(value)));
+}
+
+int main()
+{
+    // items at rows 0, 10, 20, ... holding their row as a number, every fourth one a string instead
+    std::vector<std::pair<size_t, CTotals>> items;
+    for (size_t row = 0; row < 1000; row += 10)
+    {
+        items.push_back({row, row % 40 == 30 ? CTotals::of(CContent(CValue("text"))) : number(row)});
+    }
+    CColumnTotals totals(items);
+    assert(totals.size() == 100);
+    auto brute = [&](size_t first, size_t last)
+    {
+        CTotals sum;
+        for (const auto &[row, item] : items)
+        {
+            if (row >= first && row <= last)
+            {
+                sum += item;
+            }
+        }
+        return sum;
+    };
+    for (size_t first = 0; first < 1010; first += 7)
+    {
+        for (size_t last = first; last < 1010; last += 13)
+        {
+            CTotals got = totals.query(first, last);
+            CTotals expected = brute(first, last);
+            assert(got.m_sum == expected.m_sum && got.m_numbers == expected.m_numbers && got.m_values == expected.m_values);
+        }
+    }
+    assert(totals.query(5, 9).m_values == 0 && totals.query(2000, 3000).m_values == 0);
+    assert(totals.query(0, SIZE_MAX).m_values == 100);
+
+    // updates, enough of them to rebuild the tree on the way
+    assert(!totals.update(5, number(1)));
+    for (int round = 0; round < 3; round++)
+    {
+        for (auto &[row, item] : items)
+        {
+            item = row % 20 ? number(round) : CTotals::of(CContent(), false);
+            assert(totals.update(row, item));
+        }
+        CTotals all = totals.query(0, 1000);
+        assert(all.m_sum == 50 * round && all.m_numbers == 50 && all.m_values == 50 && all.m_unknown == 50);
+    }
+    std::vector<size_t> unknown;
+    totals.forEachUnknown(15, 60, [&](size_t row)
+                          { unknown.push_back(row); });
+    assert((unknown == std::vector<size_t>{20, 40, 60}));
+
+    // huge and non-finite items dont leak into the totals of intervals without them, updates included
+    std::vector<std::pair<size_t, CTotals>> extremes = {{0, number(1e20)}, {1, number(1e308)}, {2, number(1e308)}};
+    for (size_t row = 64; row < 1000; row++)
+    {
+        extremes.push_back({row, number(1)});
+    }
+    extremes.push_back({2000, number(INFINITY)});
+    CColumnTotals wide(extremes);
+    assert(wide.query(64, 999).m_sum == 936 && wide.query(3, 1999).m_sum == 936);
+    assert(wide.query(1, 2).m_sum == INFINITY && wide.query(0, SIZE_MAX).m_sum == INFINITY);
+    assert(wide.update(1, number(-INFINITY)) && wide.update(0, number(NAN)));
+    assert(wide.query(64, 999).m_sum == 936 && std::isnan(wide.query(0, 1).m_sum) && wide.query(2, 2).m_sum == 1e308);
+    assert(wide.update(1, number(5)) && wide.update(0, number(1)));
+    assert(wide.query(0, 1).m_sum == 6 && wide.query(64, 2000).m_sum == INFINITY);
+
+    CColumnTotals empty({});
+    assert(empty.query(0, 100).m_values == 0 && !empty.update(0, number(1)));
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#include "CContent.hpp"
+#include <cassert>
+#include <limits>
+#include <vector>
+
+int main()
+{
+    static_assert(sizeof(CContent) == 8);
+    assert(CContent().isMonostate() && !CContent().isDouble() && !CContent().isString());
+    for (double x : {0.0, -0.0, 1.5, -1e300, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                     std::numeric_limits<double>::denorm_min()})
+    {
+        CContent value(x);
+        assert(value.isDouble() && std::bit_cast<uint64_t>(value.getDouble()) == std::bit_cast<uint64_t>(x));
+    }
+    // every nan, whatever its payload, stays a number
+    CContent nan(std::bit_cast<double>(uint64_t(0xfffb000000001234)));
+    assert(nan.isDouble() && std::isnan(nan.getDouble()));
+    assert((CContent(std::numeric_limits<double>::infinity()) - CContent(std::numeric_limits<double>::infinity())).isDouble());
+
+    CContent text(std::string("abc"));
+    assert(text.isString() && text.getString() == "abc");
+    {
+        CContent copy = text;
+        CContent other(std::string("x"));
+        other = copy;
+        assert(&other.getString() == &text.getString()); // copies share the string
+        other = std::move(copy);
+        assert(copy.isMonostate() && other.getString() == "abc");
+    }
+    assert(text.getString() == "abc");
+    std::vector<CContent> values(100, text);
+    values.resize(1000, CContent(2.0));
+    assert(values[99].getString() == "abc" && values[999].getDouble() == 2.0);
+
+    assert(std::get<std::string>((text + CContent(std::string("def"))).toValue()) == "abcdef");
+    assert(std::get<double>((text == CContent(CValue("abc"))).toValue()) == 1);
+    assert(std::holds_alternative<std::monostate>((text * CContent(2.0)).toValue()));
+
+    // an owned string is extended in place, a shared one is left as it is
+    CContent sum = text + CContent(std::string("d"));
+    const std::string *buffer = &sum.getString();
+    sum = std::move(sum) + text;
+    assert(&sum.getString() == buffer && sum.getString() == "abcdabc");
+    sum = std::move(sum) + CContent(1.0);
+    assert(&sum.getString() == buffer && sum.getString() == "abcdabc1.000000");
+    sum = std::move(sum) + sum;
+    assert(sum.getString() == "abcdabc1.000000abcdabc1.000000");
+    CContent shared = text;
+    CContent joined = std::move(shared) + CContent(std::string("!"));
+    assert(joined.getString() == "abc!" && text.getString() == "abc" && &joined.getString() != &text.getString());
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include "CLiteralColumns.hpp"
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+int main()
+{
+    CLiteralColumns columns;
+    assert(!columns.assign(CCellKey(0, 0), CContent()));
+    assert(columns.size() == 0 && !columns.find(CCellKey(0, 0)));
+
+    assert(columns.assign(CCellKey(0, 0), CContent(CValue(1.5))));
+    assert(columns.assign(CCellKey(63, 0), CContent(CValue("abc"))));
+    assert(columns.assign(CCellKey(64, 0), CContent(CValue(-2.0))));
+    assert(columns.assign(CCellKey(5, 3), CContent(CValue(""))));
+    assert(columns.size() == 4);
+    assert(columns.find(CCellKey(0, 0))->getDouble() == 1.5);
+    assert(columns.find(CCellKey(63, 0))->getString() == "abc");
+    assert(columns.find(CCellKey(5, 3))->getString().empty());
+    assert(!columns.contains(CCellKey(1, 0)) && !columns.contains(CCellKey(5, 2)));
+
+    // changing the type of a cell
+    assert(columns.assign(CCellKey(0, 0), CContent(CValue("x"))));
+    assert(columns.assign(CCellKey(63, 0), CContent(CValue(7.0))));
+    assert(columns.size() == 4);
+    assert(columns.find(CCellKey(0, 0))->getString() == "x");
+    assert(columns.find(CCellKey(63, 0))->getDouble() == 7.0);
+
+    std::vector<CCellKey> visited;
+    columns.forEachIn(CCellKey(1, 0), 4, 64, [&](const CCellKey &pos, const CContent &)
+                      { visited.push_back(pos); });
+    std::vector<CCellKey> expected = {CCellKey(63, 0), CCellKey(64, 0), CCellKey(5, 3)};
+    std::sort(visited.begin(), visited.end());
+    std::sort(expected.begin(), expected.end());
+    assert(visited == expected);
+    size_t count = 0;
+    columns.forEach([&](const CCellKey &, const CContent &)
+                    { count++; });
+    assert(count == 4);
+
+    // numbers of a rectangle are aggregated a segment at a time, strings only counted
+    CAggregator sum(CAggregateKind::SUM);
+    CAggregator values(CAggregateKind::COUNT);
+    columns.aggregate(CCellKey(0, 0), 4, 65, sum);
+    columns.aggregate(CCellKey(0, 0), 4, 65, values);
+    assert(sum.result().getDouble() == 5.0 && values.result().getDouble() == 4);
+    CAggregator lowest(CAggregateKind::MIN);
+    columns.aggregate(CCellKey(64, 0), CCellKey::MAX_INDEX, CCellKey::MAX_INDEX, lowest);
+    assert(lowest.result().getDouble() == -2.0);
+
+    CLiteralColumns copy = columns;
+    assert(columns.erase(CCellKey(0, 0)) && !columns.erase(CCellKey(0, 0)));
+    assert(columns.erase(CCellKey(63, 0)) && columns.size() == 2);
+    assert(copy.size() == 4 && copy.find(CCellKey(0, 0))->getString() == "x");
+    assert(columns.assign(CCellKey(1, 1), CContent(CValue("reused"))));
+    assert(columns.find(CCellKey(1, 1))->getString() == "reused");
+    columns.clear();
+    assert(columns.size() == 0 && !columns.contains(CCellKey(64, 0)));
+
+    // indexed columns answer tall rectangles from totals of whole segments, and follow changes
+    CLiteralColumns indexed;
+    indexed.setIndexed(true);
+    for (size_t row = 0; row < 2000; row++)
+    {
+        indexed.assign(CCellKey(row, 1), row % 7 ? CContent(CValue(double(row))) : CContent(CValue("seven")));
+    }
+    auto aggregate = [&](CAggregateKind kind, size_t first, size_t last)
+    {
+        CAggregator aggregator(kind);
+        indexed.aggregate(CCellKey(first, 0), 3, last - first + 1, aggregator);
+        return aggregator.result().getDouble();
+    };
+    auto expectedSum = [&](size_t first, size_t last)
+    {
+        double expected = 0;
+        indexed.forEachIn(CCellKey(first, 0), 3, last - first + 1, [&](const CCellKey &, const CContent &value)
+                          { expected += value.isDouble() ? value.getDouble() : 0; });
+        return expected;
+    };
+    assert(aggregate(CAggregateKind::SUM, 3, 1900) == expectedSum(3, 1900));
+    assert(aggregate(CAggregateKind::COUNT, 3, 1900) == 1898);
+    indexed.assign(CCellKey(500, 1), CContent(CValue(-1000.0)));
+    assert(indexed.erase(CCellKey(501, 1)));
+    indexed.assign(CCellKey(5000, 1), CContent(CValue(1.0)));
+    indexed.assign(CCellKey(600, 2), CContent(CValue(2.0)));
+    assert(aggregate(CAggregateKind::SUM, 0, 6000) == expectedSum(0, 6000));
+    assert(aggregate(CAggregateKind::SUM, 64, 1919) == expectedSum(64, 1919));
+    assert(aggregate(CAggregateKind::MAX, 0, 6000) == 1999);
+    assert(aggregate(CAggregateKind::COUNT, 0, 6000) == 2001);
+    for (size_t row = 0; row < 2000; row++)
+    {
+        indexed.erase(CCellKey(row, 1));
+    }
+    assert(aggregate(CAggregateKind::SUM, 0, 6000) == 3.0);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include "CLookupIndex.hpp"
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+CCellRange rangeOf(size_t firstRow, size_t firstCol, size_t lastRow, size_t lastCol)
+{
+    return CCellRange(CCellKey(firstRow, firstCol), CCellKey(lastRow, lastCol));
+}
+
+int main()
+{
+    // cells added out of order, the first match is the smallest offset
+    CLookupIndex index;
+    index.add(CContent(CValue(5.0)), 7);
+    index.add(CContent(CValue("five")), 3);
+    index.add(CContent(CValue(5.0)), 2);
+    index.add(CContent(CValue(-0.0)), 9);
+    index.add(CContent(CValue(0.0)), 4);
+    index.add(CContent(), 0);
+    index.add(CContent(CValue(std::nan(""))), 1);
+    assert(index.size() == 5);
+    assert(index.find(CContent(CValue(5.0))).m_first == 2 && index.find(CContent(CValue(5.0))).m_count == 2);
+    assert(index.find(CContent(CValue("five"))).m_first == 3 && index.find(CContent(CValue("five"))).m_count == 1);
+    assert(index.find(CContent(CValue(0.0))).m_first == 4 && index.find(CContent(CValue(-0.0))).m_count == 2);
+    assert(index.find(CContent(CValue("5"))).m_count == 0);
+    assert(index.find(CContent()).m_count == 0);
+    assert(index.find(CContent(CValue(std::nan("")))).m_count == 0);
+
+    // ranges containing a cell are dropped with it, others are kept
+    CLookupCache cache;
+    CLookupIndex column;
+    for (size_t row = 0; row < 100; row++)
+    {
+        column.add(CContent(CValue(double(row % 10))), row);
+    }
+    cache.insert(rangeOf(0, 0, 99, 0), column);
+    cache.insert(rangeOf(0, 0, 9, 200), CLookupIndex());
+    cache.insert(rangeOf(0, 1, 99, 1), CLookupIndex());
+    assert(cache.size() == 3);
+    assert(cache.find(rangeOf(0, 0, 99, 0), CContent(CValue(3.0)))->m_count == 10);
+    assert(!cache.find(rangeOf(0, 0, 98, 0), CContent(CValue(3.0))));
+    cache.drop(CCellKey(50, 0));
+    assert(cache.size() == 2 && !cache.find(rangeOf(0, 0, 99, 0), CContent(CValue(3.0))));
+    cache.drop(CCellKey(5, 150));
+    assert(cache.size() == 1 && cache.find(rangeOf(0, 1, 99, 1), CContent()));
+    cache.drop(CCellKey(100, 1));
+    assert(cache.size() == 1);
+    // ranges over the whole width of the sheet are dropped the same way
+    cache.insert(rangeOf(0, 0, 9, CCellKey::MAX_INDEX), column);
+    cache.insert(rangeOf(0, 64 * 64, 9, 64 * 128), CLookupIndex());
+    assert(cache.size() == 3);
+    cache.drop(CCellKey(10, CCellKey::MAX_INDEX));
+    assert(cache.size() == 3);
+    cache.drop(CCellKey(9, CCellKey::MAX_INDEX));
+    assert(cache.size() == 2 && !cache.find(rangeOf(0, 0, 9, CCellKey::MAX_INDEX), CContent()));
+    cache.drop(CCellKey(0, 64 * 100));
+    assert(cache.size() == 1);
+    CLookupCache copy(cache);
+    assert(copy.size() == 0);
+    CLookupCache moved(std::move(cache));
+    assert(moved.size() == 1);
+    moved.clear();
+    assert(moved.size() == 0);
+
+    // threads looking up and indexing the same ranges
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&]()
+                             {
+            for (size_t col = 0; col < 100; col++)
+            {
+                CCellRange range = rangeOf(0, col, 99, col);
+                if (!moved.find(range, CContent(CValue(1.0))))
+                {
+                    moved.insert(range, column);
+                }
+                assert(moved.find(range, CContent(CValue(1.0)))->m_first == 1);
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    assert(moved.size() == 100);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
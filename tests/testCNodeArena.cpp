@@ -0,0 +1,56 @@
+#include "CNodeArena.hpp"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+struct CCounted
+{
+    static inline int alive = 0;
+    CCounted() { alive++; }
+    virtual ~CCounted() { alive--; }
+};
+
+int main()
+{
+    CNodeArenaPtr arena(new CNodeArena());
+    void *a = arena->allocate(24);
+    void *b = arena->allocate(40);
+    assert(a != b);
+    assert(reinterpret_cast<uintptr_t>(a) % CNodeArena::ALIGNMENT == 0);
+    assert(reinterpret_cast<uintptr_t>(b) % CNodeArena::ALIGNMENT == 0);
+    assert(arena->liveBytes() == 32 + 48);
+
+    // freed node is reused by an allocation of the same size class, its size is found without being passed
+    arena->deallocate(a);
+    assert(arena->freeBytes() == 32);
+    void *c = arena->allocate(20);
+    assert(c == a);
+    assert(arena->freeBytes() == 0);
+
+    // many nodes of one size class span several blocks
+    std::vector<void *> many;
+    for (size_t i = 0; i < 3 * CNodeArena::BLOCK_SIZE / 64; i++)
+    {
+        many.push_back(arena->allocate(64));
+    }
+    for (void *node : many)
+    {
+        arena->deallocate(node);
+    }
+    assert(arena->freeBytes() == many.size() * 64);
+
+    // deleter destroys the node and returns its memory
+    CArenaDeleter<CCounted> deleter{arena.get()};
+    deleter(new (arena->allocate(sizeof(CCounted))) CCounted());
+    assert(CCounted::alive == 0);
+    CArenaDeleter<CCounted>{nullptr}(new CCounted());
+    assert(CCounted::alive == 0);
+
+    // released arena stays alive until its last node is freed
+    CNodeArena *raw = arena.release();
+    raw->release();
+    raw->deallocate(b);
+    raw->deallocate(c);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#include "CSpreadsheet.hpp"
+#include <cassert>
+#include <sstream>
+
+std::shared_ptr<const CFormula> parse(const std::string &text)
+{
+    CAstBuilder builder;
+    CParser::parse(text, builder);
+    auto formula = std::make_shared<CFormula>();
+    formula->m_expr = builder.getResult();
+    formula->m_expr->compile(formula->m_program);
+    return formula;
+}
+
+std::string print(const CExpr &expr)
+{
+    std::ostringstream oss;
+    oss << expr;
+    return oss.str();
+}
+
+int main()
+{
+    CParseCache cache(2);
+    assert(!cache.find("=A1+1"));
+    std::shared_ptr<const CFormula> first = parse("=A1+1");
+    cache.insert("=A1+1", first);
+    cache.insert("=B2*2", parse("=B2*2"));
+    assert(cache.find("=A1+1") == first && cache.size() == 2);
+    // =B2*2 is now the least recently used one
+    cache.insert("=C3", parse("=C3"));
+    assert(cache.size() == 2 && !cache.find("=B2*2") && cache.find("=A1+1") == first && cache.find("=C3"));
+    cache.clear();
+    assert(cache.size() == 0 && !cache.find("=C3"));
+
+    // cells filled with the same text share the formula, copies read the cells moved by the copy
+    CSpreadsheet sheet;
+    assert(sheet.setCell(CPos("A1"), "1"));
+    for (int row = 2; row <= 100; row++)
+    {
+        assert(sheet.setCell(CPos(row, 1), "=A1 + 1"));
+    }
+    sheet.copyRect(CPos("C2"), CPos("B2"));
+    assert(print(*sheet.getCell(CPos("B2"))) == print(*sheet.getCell(CPos("B50"))));
+    assert(print(*sheet.getCell(CPos("C2"))) != print(*sheet.getCell(CPos("B2"))));
+    assert(sheet.setCell(CPos("B101"), "=A1 + 1"));
+    assert(std::get<double>(sheet.getValue(CPos("B101"))) == 2);
+    assert(!sheet.setCell(CPos("B102"), "=A1 +"));
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include "CParser.hpp"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+// writes the calls it receives in postfix notation
+class CRecorder : public CExprBuilder
+{
+public:
+    void opAdd() override { m_out << "+ "; }
+    void opSub() override { m_out << "- "; }
+    void opMul() override { m_out << "* "; }
+    void opDiv() override { m_out << "/ "; }
+    void opPow() override { m_out << "^ "; }
+    void opNeg() override { m_out << "neg "; }
+    void opEq() override { m_out << "= "; }
+    void opNe() override { m_out << "<> "; }
+    void opLt() override { m_out << "< "; }
+    void opLe() override { m_out << "<= "; }
+    void opGt() override { m_out << "> "; }
+    void opGe() override { m_out << ">= "; }
+    void valNumber(double val) override { m_out << val << " "; }
+    void valString(std::string val) override { m_out << "'" << val << "' "; }
+    void valReference(std::string val) override { m_out << "ref:" << val << " "; }
+    void valRange(std::string val) override { m_out << "range:" << val << " "; }
+    void funcCall(std::string fnName, int paramCount) override { m_out << fnName << "/" << paramCount << " "; }
+    std::ostringstream m_out;
+};
+
+std::string parse(std::string_view input)
+{
+    CRecorder recorder;
+    CParser::parse(input, recorder);
+    return recorder.m_out.str();
+}
+
+bool fails(std::string_view input)
+{
+    try
+    {
+        parse(input);
+    }
+    catch (std::invalid_argument &e)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    // plain values
+    assert(parse("12.5") == "12.5 ");
+    assert(parse("-3e2") == "-300 ");
+    assert(parse("12abc") == "'12abc' ");
+    assert(parse("inf") == "'inf' ");
+    assert(parse("") == "'' ");
+    assert(parse(" 1") == "' 1' ");
+
+    // precedence and associativity
+    assert(parse("=1+2*3") == "1 2 3 * + ");
+    assert(parse("=1-2-3") == "1 2 - 3 - ");
+    assert(parse("=2^3^2") == "2 3 ^ 2 ^ ");
+    assert(parse("=-2^2") == "2 2 ^ neg ");
+    assert(parse("=2^-1") == "2 1 neg ^ ");
+    assert(parse("=1 + 2 < 3 * 4") == "1 2 + 3 4 * < ");
+    assert(parse("=1<>2<=3>=4<5>6=7") == "1 2 <> 3 <= 4 >= 5 < 6 > 7 = ");
+    assert(parse("= ( 1 + 2 ) * 3 ") == "1 2 + 3 * ");
+    assert(parse("=30^2 - (20 + 30) / (-40 * 50)") == "30 2 ^ 20 30 + 40 neg 50 * / - ");
+
+    // operands
+    assert(parse("=\"a\"\"b\"\"\" + \"\"") == "'a\"b\"' '' + ");
+    assert(parse("=$A$1 + b2 * AB$10") == "ref:$A$1 ref:b2 ref:AB$10 * + ");
+    assert(parse("=A1:$B$2") == "range:A1:$B$2 ");
+    assert(parse("=SUM(A1:A10, 2) + pi() + LOG10(B1)") == "range:A1:A10 2 SUM/2 pi/0 + ref:B1 LOG10/1 + ");
+    assert(parse("=IF(A1 > 0, \"pos\", -A1)") == "ref:A1 0 > 'pos' ref:A1 neg IF/3 ");
+    assert(parse("=#REF! + SUM(#REF!:#REF!)") == "ref:#REF! range:#REF!:#REF! SUM/1 + ");
+
+    // syntax errors
+    for (std::string_view input : {"=", "=1+", "=(1", "=1)", "=\"abc", "=A", "=A1:", "=SUM(1,", "=1 2", "=#", "=#REF", "=."})
+    {
+        assert(fails(input));
+    }
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -1,40 +1,41 @@
 #include "CPos.hpp"
 #include <cassert>
+#include <sstream>
 
 int main()
 {
     CPos x0("A23");
-    assert(x0.m_col == 1);
+    assert(x0.m_col == 0);
     assert(!x0.m_isAbsCol);
     // row
     assert(x0.m_row == 23);
     assert(!x0.m_isAbsRow);
     CPos x1("ABC23");
-    assert(x1.m_col == 731);
+    assert(x1.m_col == 730);
     assert(!x1.m_isAbsCol);
 
     assert(x1.m_row == 23);
     assert(!x1.m_isAbsRow);
     CPos x2("AAA23");
-    assert(x2.m_col == 703);
+    assert(x2.m_col == 702);
 
     assert(x2.m_row == 23);
     assert(!x2.m_isAbsRow);
     CPos x3("$B23");
-    assert(x3.m_col == 2);
+    assert(x3.m_col == 1);
     assert(x3.m_isAbsCol);
 
     assert(x3.m_row == 23);
     assert(!x3.m_isAbsRow);
     CPos x4("B$23");
-    assert(x4.m_col == 2);
+    assert(x4.m_col == 1);
     assert(!x4.m_isAbsCol);
 
     assert(x4.m_row == 23);
     assert(x4.m_isAbsRow);
 
     CPos x5("$B$1234");
-    assert(x5.m_col == 2);
+    assert(x5.m_col == 1);
     assert(x5.m_isAbsCol);
 
     assert(x5.m_row == 1234);
@@ -72,5 +73,34 @@ int main()
     {
         std::cout << e.what() << std::endl;
     }
+    for (std::string_view bad : {"", "$", "A", "A$", "$$1", "1A", "A 1", "A$ 1", "A+1", "A-1", "A1$", "A99999999999999999999", "AAAAAAAAAAAAAAAAAAAAA1"})
+    {
+        try
+        {
+            CPos bad_pos(bad);
+            assert(false);
+        }
+        catch (const std::invalid_argument &e)
+        {
+        }
+    }
+
+    // the parser runs at compile time as well
+    static_assert(CPos("zz10").m_col == 701 && CPos("$AAA$0").m_col == 702 && CPos("$AAA$0").m_isAbsRow);
+
+    // printing and parsing are inverse
+    for (std::string str : {"A0", "Z1", "AA2", "AZ3", "BA4", "ZZ5", "AAA6", "$XFD$1048576"})
+    {
+        std::ostringstream oss;
+        oss << CPos(str);
+        assert(oss.str() == str);
+    }
+    for (size_t col : {(size_t)0, (size_t)25, (size_t)26, (size_t)701, (size_t)702, (size_t)123456789, SIZE_MAX - 1})
+    {
+        std::ostringstream oss;
+        oss << CPos(7, col);
+        assert(CPos(oss.str()).m_col == col);
+    }
+    std::cout << "PASSED" << std::endl;
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "CSpreadsheet.hpp"
+#include <cassert>
+
+CContent compileAndRun(const std::string &expr, const CSpreadsheet &sheet)
+{
+    CAstBuilder builder;
+    CParser::parse(expr, builder);
+    CProgram program;
+    builder.getResult()->compile(program);
+    return program.run(sheet, CCellShift());
+}
+
+// the program has to agree with evaluating the tree, jumps included
+CContent compileAndCheck(const std::string &expr, const CSpreadsheet &sheet)
+{
+    CAstBuilder builder;
+    CParser::parse(expr, builder);
+    CExprPtr tree = builder.getResult();
+    CProgram program;
+    tree->compile(program);
+    CContent result = program.run(sheet, CCellShift());
+    CContent expected = tree->eval(sheet, CCellShift());
+    assert(result.isMonostate() == expected.isMonostate() && (result.isMonostate() || result.equals(expected)));
+    return result;
+}
+
+int main()
+{
+    CSpreadsheet sheet;
+    assert(sheet.setCell(CPos("A1"), "10"));
+    assert(sheet.setCell(CPos("A2"), "=A1*2"));
+    assert(sheet.setCell(CPos("A3"), "abc"));
+
+    assert(compileAndRun("=42", sheet).getDouble() == 42);
+    assert(compileAndRun("=30^2 - (20 + 30) / (-40 * 50)", sheet).getDouble() == 900.025);
+    assert(compileAndRun("=-A1 ^ 2 - A2 / 2", sheet).getDouble() == -110);
+    assert(compileAndRun("=(A1 < A2) + (A1 >= A2) * 2 + (A1 <> A2) * 4", sheet).getDouble() == 5);
+    assert(compileAndRun("=A3 + \"def\"", sheet).getString() == "abcdef");
+    assert(compileAndRun("=A3 = \"abc\"", sheet).getDouble() == 1);
+    assert(compileAndRun("=A1 / 0", sheet).isMonostate());
+    assert(compileAndRun("=A1 + B7", sheet).isMonostate());
+
+    assert(compileAndCheck("=IF(A1 > 5, A2, A3)", sheet).getDouble() == 20);
+    assert(compileAndCheck("=IF(A1 < 5, A2, A3)", sheet).getString() == "abc");
+    assert(compileAndCheck("=IF(A1 < 5, A2)", sheet).getDouble() == 0);
+    assert(compileAndCheck("=IF(A3, 1, 2)", sheet).isMonostate());
+    assert(compileAndCheck("=1 + IF(B7, 1, 2)", sheet).isMonostate());
+    assert(compileAndCheck("=IF(A1, IF(0, 1, A2 + 1), 3) * 2", sheet).getDouble() == 42);
+    assert(compileAndCheck("=AND(A1, A2, 1)", sheet).getDouble() == 1);
+    assert(compileAndCheck("=AND(A1, 0, A3)", sheet).getDouble() == 0);
+    assert(compileAndCheck("=AND(A1, A3, 0)", sheet).isMonostate());
+    assert(compileAndCheck("=OR(0, A1 = 10, A3)", sheet).getDouble() == 1);
+    assert(compileAndCheck("=OR(0, B7)", sheet).isMonostate());
+    assert(compileAndCheck("=OR(0, 0)", sheet).getDouble() == 0);
+    assert(compileAndCheck("=CHOOSE(2.9, A1, A2, A3)", sheet).getDouble() == 20);
+    assert(compileAndCheck("=CHOOSE(3, A1, A2, A3)", sheet).getString() == "abc");
+    assert(compileAndCheck("=CHOOSE(4, A1, A2, A3)", sheet).isMonostate());
+    assert(compileAndCheck("=CHOOSE(A3, A1)", sheet).isMonostate());
+    assert(compileAndCheck("=CHOOSE(1, A1, A2) + CHOOSE(2, A1, A2)", sheet).getDouble() == 30);
+    assert(compileAndCheck("=IFERROR(A1 / 0, -1)", sheet).getDouble() == -1);
+    assert(compileAndCheck("=IFERROR(A3, -1)", sheet).getString() == "abc");
+    assert(compileAndCheck("=SUM(IF(A1, A1:A3, 0), 5)", sheet).getDouble() == 5);
+    assert(compileAndCheck("=#REF! + SUM(#REF!:#REF!, 1) + COUNTIF(#REF!:#REF!, 1)", sheet).isMonostate());
+    assert(compileAndCheck("=SUM(#REF!:#REF!, A1:A2, 1)", sheet).getDouble() == 31);
+
+    // only relative parts of references decide if the program can be moved
+    CAstBuilder builder;
+    CParser::parse("=$A1 + C$2 + SUM(B3:$D$9)", builder);
+    CProgram program;
+    builder.getResult()->compile(program);
+    assert(program.fitsAt(CCellShift{-1, -1}) && program.fitsAt(CCellShift{-1, 0}));
+    assert(!program.fitsAt(CCellShift{-2, 0}) && !program.fitsAt(CCellShift{0, -2}));
+    assert(!program.fitsAt(CCellShift{static_cast<int64_t>(CCellKey::MAX_INDEX) - 2, 0}));
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
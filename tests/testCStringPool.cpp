@@ -0,0 +1,52 @@
+#include "CStringPool.hpp"
+#include <cassert>
+#include <thread>
+#include <vector>
+
+int main()
+{
+    CContent outliving;
+    {
+        CStringPool pool;
+        CContent a = pool.intern("category");
+        CContent b = pool.intern(CContent(std::string("category")));
+        CContent c = pool.intern("other");
+        assert(&a.getString() == &b.getString() && pool.size() == 2);
+        assert(a.equals(b) && !a.equals(c));
+        assert(a.equals(CContent(std::string("category"))) && !c.equals(CContent(std::string("categor"))));
+        assert(&pool.intern(a).getString() == &a.getString());
+        assert(pool.intern(CContent(1.0)).getDouble() == 1.0);
+
+        // strings used only by the pool are dropped once it grows
+        for (int i = 0; i < 5000; i++)
+        {
+            pool.intern("tmp" + std::to_string(i));
+        }
+        assert(pool.size() < 2500);
+        assert(pool.intern("category").getString() == "category" && &pool.intern("category").getString() == &a.getString());
+
+        std::vector<std::thread> threads;
+        std::vector<CContent> results(8);
+        for (int i = 0; i < 8; i++)
+        {
+            threads.emplace_back([&, i]()
+                                 {
+                for (int j = 0; j < 2000; j++)
+                {
+                    results[i] = pool.intern("shared" + std::to_string(j % 10));
+                } });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        for (const auto &result : results)
+        {
+            assert(&result.getString() == &results[0].getString());
+        }
+        outliving = a;
+    }
+    assert(outliving.getString() == "category" && outliving.equals(CContent(std::string("category"))));
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include "CTiledTable.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main()
+{
+    CTiledTable<std::string> table;
+    assert(table.size() == 0 && !table.find(CCellKey(0, 0)));
+    table.assign(CCellKey(0, 0), "a");
+    table.assign(CCellKey(31, 7), "b");  // same tile
+    table.assign(CCellKey(32, 8), "c");  // next tile
+    table.assign(CCellKey(CCellKey::MAX_INDEX, CCellKey::MAX_INDEX), "d");
+    table.assign(CCellKey(0, 0), "e"); // overwrite
+    assert(table.size() == 4);
+    assert(*table.find(CCellKey(0, 0)) == "e" && *table.find(CCellKey(31, 7)) == "b");
+    assert(!table.contains(CCellKey(1, 0)) && !table.contains(CCellKey(32, 9)));
+
+    std::vector<CCellKey> visited;
+    table.forEachIn(CCellKey(0, 0), 9, 33, [&](const CCellKey &key, const std::string &)
+                    { visited.push_back(key); });
+    assert(visited.size() == 3);
+    visited.clear();
+    table.forEachIn(CCellKey(1, 1), 100, 100, [&](const CCellKey &key, const std::string &)
+                    { visited.push_back(key); });
+    std::sort(visited.begin(), visited.end());
+    assert(visited.size() == 2 && visited[0] == CCellKey(31, 7) && visited[1] == CCellKey(32, 8));
+    visited.clear();
+    table.forEachIn(CCellKey(CCellKey::MAX_INDEX - 3, CCellKey::MAX_INDEX - 3), 10, 10, [&](const CCellKey &key, const std::string &)
+                    { visited.push_back(key); });
+    assert(visited.size() == 1);
+    visited.clear();
+    // far more tiles in the rectangle than in the table, the table is walked instead
+    table.forEachIn(CCellKey(1, 0), CCellKey::MAX_INDEX + 1, CCellKey::MAX_INDEX, [&](const CCellKey &key, const std::string &)
+                    { visited.push_back(key); });
+    assert(visited.size() == 3 && std::find(visited.begin(), visited.end(), CCellKey(0, 0)) == visited.end());
+
+    size_t count = 0;
+    table.forEach([&](const CCellKey &, std::string &value)
+                  { value += "!"; count++; });
+    assert(count == 4 && *table.find(CCellKey(32, 8)) == "c!");
+
+    assert(table.erase(CCellKey(31, 7)) && !table.erase(CCellKey(31, 7)));
+    assert(table.erase(CCellKey(0, 0)));
+    assert(table.size() == 2 && !table.contains(CCellKey(0, 0)));
+    table.clear();
+    assert(table.size() == 0 && !table.contains(CCellKey(32, 8)));
+
+    // dense block
+    for (size_t i = 0; i < 1000; i++)
+    {
+        for (size_t j = 0; j < 200; j++)
+        {
+            table.assign(CCellKey(i, j), "x");
+        }
+    }
+    count = 0;
+    table.forEachIn(CCellKey(10, 5), 100, 500, [&](const CCellKey &key, const std::string &)
+                    { count++; assert(key.getRow() >= 10 && key.getRow() < 510 && key.getCol() >= 5 && key.getCol() < 105); });
+    assert(count == 50000);
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}